@@ -0,0 +1,144 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <libbase/memory_scan.h>
+#include <libbase/thread_pool.h>
+
+namespace {
+
+    const char kHexDigits[] = "0123456789abcdef";
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * a memory dump like buffer: zero pages, random pages and low entropy pages
+     */
+    std::vector<uint8_t> makeBuffer(size_t size, std::mt19937_64 &rng) {
+        std::vector<uint8_t> buffer(size);
+        for (size_t page = 0; page < size; page += 4096u) {
+            const size_t page_size = std::min<size_t>(4096u, size - page);
+            uint8_t *data = buffer.data() + page;
+            switch (rng() % 3u) {
+                case 0:
+                    memset(data, 0, page_size);
+                    break;
+                case 1:
+                    for (size_t i = 0; i < page_size; ++i) {
+                        data[i] = static_cast<uint8_t>(rng());
+                    }
+                    break;
+                default:
+                    for (size_t i = 0; i < page_size; ++i) {
+                        data[i] = static_cast<uint8_t>('a' + rng() % 26u);
+                    }
+                    break;
+            }
+        }
+        return buffer;
+    }
+
+    /**
+     * random 8 to 15 byte signatures, each planted a few times in the buffer,
+     * with two wildcard bytes when |wildcards| is set
+     */
+    std::vector<std::string> makePatterns(size_t count, bool wildcards, std::vector<uint8_t> *buffer,
+                                          std::mt19937_64 &rng) {
+        std::vector<std::string> patterns;
+        for (size_t i = 0; i < count; ++i) {
+            const size_t size = 8u + rng() % 8u;
+            uint8_t signature[16];
+            std::string pattern;
+            for (size_t k = 0; k < size; ++k) {
+                signature[k] = static_cast<uint8_t>(rng());
+                pattern += kHexDigits[signature[k] >> 4];
+                pattern += kHexDigits[signature[k] & 0xf];
+                pattern += ' ';
+            }
+            for (int copy = 0; copy < 4; ++copy) {
+                memcpy(buffer->data() + rng() % (buffer->size() - size), signature, size);
+            }
+            if (wildcards) {
+                pattern.replace(6, 2, "??");
+                pattern.replace(15, 2, "??");
+            }
+            patterns.push_back(pattern);
+        }
+        return patterns;
+    }
+
+}  // namespace
+
+/**
+ * throughput of MemoryScan, run once per pattern, against one MultiMemoryScan pass over all of them
+ * usage: memory_scan_benchmark [buffer MiB, default 64] [threads, default all cores]
+ */
+int main(int argc, char **argv) {
+    const size_t size = (argc > 1 ? strtoul(argv[1], nullptr, 10) : 64u) << 20;
+    const size_t thread_count = argc > 2 ? strtoul(argv[2], nullptr, 10) : base::ThreadPool::DefaultThreadCount();
+    if (size == 0u) {
+        fprintf(stderr, "usage: %s [buffer MiB] [threads]\n", argv[0]);
+        return 1;
+    }
+    std::mt19937_64 rng(7);
+    base::ThreadPool thread_pool(thread_count);
+    const double gigabytes = size / 1e9;
+    printf("%zu MiB buffer, %zu threads, throughput in GB/s (matches)\n", size >> 20, thread_count);
+    printf("%-9s %8s %18s %18s %18s\n", "patterns", "masks", "MemoryScan", "Multi 1 thread", "Multi threads");
+    for (bool wildcards : {false, true}) {
+        for (size_t count : {1u, 16u, 256u}) {
+            std::vector<uint8_t> buffer = makeBuffer(size, rng);
+            std::vector<std::string> patterns = makePatterns(count, wildcards, &buffer, rng);
+
+            size_t old_matches = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const std::string &pattern : patterns) {
+                MemoryScan memory_scan(pattern);
+                memory_scan.memoryScanSync(buffer.data(), buffer.size(), [&old_matches](uint8_t *) {
+                    ++old_matches;
+                    return true;
+                });
+            }
+            const double old_seconds = secondsSince(start);
+
+            std::string error_msg;
+            std::unique_ptr<MultiMemoryScan> multi_scan(MultiMemoryScan::Create(patterns, &error_msg));
+            if (multi_scan == nullptr) {
+                fprintf(stderr, "create fail: %s\n", error_msg.c_str());
+                return 1;
+            }
+            size_t serial_matches = 0;
+            start = std::chrono::steady_clock::now();
+            multi_scan->Scan(buffer.data(), buffer.size(),
+                             [&serial_matches](const MultiMemoryScan::Match *, size_t matches) {
+                                 serial_matches += matches;
+                                 return true;
+                             });
+            const double serial_seconds = secondsSince(start);
+
+            size_t parallel_matches = 0;
+            start = std::chrono::steady_clock::now();
+            multi_scan->Scan(buffer.data(), buffer.size(),
+                             [&parallel_matches](const MultiMemoryScan::Match *, size_t matches) {
+                                 parallel_matches += matches;
+                                 return true;
+                             }, &thread_pool);
+            const double parallel_seconds = secondsSince(start);
+
+            printf("%-9zu %8s %10.2f (%5zu) %10.2f (%5zu) %10.2f (%5zu)\n", count, wildcards ? "??" : "exact",
+                   gigabytes / old_seconds, old_matches, gigabytes / serial_seconds, serial_matches,
+                   gigabytes / parallel_seconds, parallel_matches);
+        }
+    }
+    return 0;
+}
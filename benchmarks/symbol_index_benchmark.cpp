@@ -0,0 +1,152 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <libdex/dex/dex_file.h>
+#include <libdex/header.h>
+#include <libdex/decompilation.h>
+#include <libdex/symbol_index.h>
+#include <libbase/file.h>
+
+namespace {
+
+    const std::vector<std::string> kSubstrings = {
+            "a", "Lj", "java", "Ljava/lang/", "String", "<init>", "Exception", "android", "zzzq", "/"};
+
+    const std::vector<std::string> kRegexes = {
+            "Ljava/lang/.*", ".*String.*", "L.*;", "m[0-9]+", "(a|b).*", "<init>", ".*Exception.*",
+            ".*\\(\\).*", "L[a-z]+/.*;", ".*1"};
+
+    struct Results {
+        std::vector<std::set<dex_ir::StringId *>> substrings;
+        std::vector<std::set<dex_ir::StringId *>> regexes;
+        std::vector<dex_ir::MethodId *> methods;
+    };
+
+    struct Timings {
+        double substrings = 0;
+        double regexes = 0;
+        double methods = 0;
+    };
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * every |step|th method id of the dex and one that does not exist
+     */
+    std::vector<dex_ir::MemberSignature> methodSignatures(dex_ir::Header *header, size_t step) {
+        std::vector<dex_ir::MemberSignature> signatures;
+        for (size_t i = 0; i < header->MethodIds().Size(); i += step) {
+            dex_ir::MethodId *method_id = header->MethodIds()[i];
+            signatures.push_back({method_id->Class()->GetStringId()->Data(),
+                                  method_id->Name()->Data(),
+                                  method_id->Proto()->GetSignatureForProtoId()});
+        }
+        signatures.push_back({"Lno/such/Class;", "missing", "()V"});
+        return signatures;
+    }
+
+    /**
+     * runs every query |repeat| times through the single query methods
+     */
+    Results runQueries(dex_ir::Decompilation *decompilation,
+                       const std::vector<dex_ir::MemberSignature> &signatures,
+                       size_t repeat,
+                       Timings *timings) {
+        Results results;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeat; ++r) {
+            results.substrings.clear();
+            for (const std::string &value : kSubstrings) {
+                results.substrings.push_back(decompilation->getStringIdAllContains(value));
+            }
+        }
+        timings->substrings = millisecondsSince(start) / repeat;
+
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeat; ++r) {
+            results.regexes.clear();
+            for (const std::string &regex : kRegexes) {
+                results.regexes.push_back(decompilation->getStringIdRegex(regex));
+            }
+        }
+        timings->regexes = millisecondsSince(start) / repeat;
+
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < repeat; ++r) {
+            results.methods.clear();
+            for (const dex_ir::MemberSignature &signature : signatures) {
+                results.methods.push_back(decompilation->getMethodIdBySignatrue(signature.class_name,
+                                                                                signature.name,
+                                                                                signature.signature));
+            }
+        }
+        timings->methods = millisecondsSince(start) / repeat;
+        return results;
+    }
+
+    void printRow(const char *query, size_t count, double linear, double indexed) {
+        printf("%-28s %8zu %12.3f %12.3f %9.1fx\n", query, count, linear, indexed,
+               indexed > 0 ? linear / indexed : 0.0);
+    }
+
+}  // namespace
+
+/**
+ * time of the Decompilation symbol queries scanning the ids against the same queries answered
+ * by the SymbolIndex, checking that both return the same ids
+ * usage: symbol_index_benchmark <dex file> [repeat, default 3]
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <dex file> [repeat]\n", argv[0]);
+        return 1;
+    }
+    const size_t repeat = argc > 2 ? std::max<size_t>(1u, strtoul(argv[2], nullptr, 10)) : 3u;
+    std::string data;
+    if (!base::ReadFileToString(argv[1], &data)) {
+        fprintf(stderr, "read fail: %s\n", argv[1]);
+        return 1;
+    }
+    std::unique_ptr<libdex::DexFile> dex_file(
+            libdex::DexFile::getDexFile(reinterpret_cast<const uint8_t *>(data.data()), data.size()));
+    std::unique_ptr<dex_ir::Header> header(dex_ir::DexIrBuilder(*dex_file, true));
+    dex_ir::Decompilation *decompilation = header->GetDecompilation();
+    const std::vector<dex_ir::MemberSignature> signatures = methodSignatures(header.get(), 7u);
+
+    Timings linear_timings;
+    Results linear = runQueries(decompilation, signatures, repeat, &linear_timings);
+
+    auto start = std::chrono::steady_clock::now();
+    if (!decompilation->loadSymbolIndex()) {
+        fprintf(stderr, "load symbol index fail\n");
+        return 1;
+    }
+    const double build = millisecondsSince(start);
+
+    Timings indexed_timings;
+    Results indexed = runQueries(decompilation, signatures, repeat, &indexed_timings);
+
+    printf("%zu strings, %zu method ids, symbol index built in %.3f ms\n", header->StringIds().Size(),
+           header->MethodIds().Size(), build);
+    printf("%-28s %8s %12s %12s %10s\n", "query (ms per batch)", "queries", "linear", "indexed", "speedup");
+    printRow("getStringIdAllContains", kSubstrings.size(), linear_timings.substrings, indexed_timings.substrings);
+    printRow("getStringIdRegex", kRegexes.size(), linear_timings.regexes, indexed_timings.regexes);
+    printRow("getMethodIdBySignatrue", signatures.size(), linear_timings.methods, indexed_timings.methods);
+
+    if (linear.substrings != indexed.substrings || linear.regexes != indexed.regexes ||
+        linear.methods != indexed.methods) {
+        fprintf(stderr, "indexed results differ from the linear scan\n");
+        return 1;
+    }
+    return 0;
+}
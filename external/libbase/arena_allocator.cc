@@ -0,0 +1,106 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <stdlib.h>
+
+#include "arena_allocator.h"
+#include "logging.h"
+
+namespace base {
+
+    namespace {
+        std::atomic<uint64_t> next_arena_id(1);
+
+        struct ThreadBlockCache {
+            uint64_t arena_id = 0;
+            void *block = nullptr;
+        };
+
+        thread_local ThreadBlockCache thread_block_cache;
+    }
+
+    ArenaAllocator::ArenaAllocator(size_t block_size)
+            : block_size_(block_size), id_(next_arena_id.fetch_add(1, std::memory_order_relaxed)) {
+    }
+
+    ArenaAllocator::~ArenaAllocator() {
+        for (uint8_t *block : blocks_) {
+            free(block);
+        }
+    }
+
+    ArenaAllocator::ThreadBlock *ArenaAllocator::CurrentThreadBlock() {
+        ThreadBlockCache &cache = thread_block_cache;
+        if (cache.arena_id != id_) {
+            std::lock_guard<std::mutex> guard(lock_);
+            std::unique_ptr<ThreadBlock> &block = thread_blocks_[std::this_thread::get_id()];
+            if (block == nullptr) {
+                block.reset(new ThreadBlock());
+            }
+            cache.arena_id = id_;
+            cache.block = block.get();
+        }
+        return static_cast<ThreadBlock *>(cache.block);
+    }
+
+    void *ArenaAllocator::Alloc(size_t bytes, size_t alignment) {
+        DCHECK_NE(alignment, 0u);
+        DCHECK_EQ(alignment & (alignment - 1), 0u);
+        ThreadBlock *block = CurrentThreadBlock();
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(block->ptr) + alignment - 1) & ~(alignment - 1);
+        if (block->ptr == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(block->end)) {
+            // Oversized requests get a block of their own so the current block keeps its free space.
+            if (bytes + alignment > block_size_ / 4) {
+                uint8_t *oversized;
+                {
+                    std::lock_guard<std::mutex> guard(lock_);
+                    oversized = AllocBlock(bytes + alignment);
+                }
+                block->bytes_used.store(block->bytes_used.load(std::memory_order_relaxed) + bytes + alignment,
+                                        std::memory_order_relaxed);
+                return reinterpret_cast<void *>(
+                        (reinterpret_cast<uintptr_t>(oversized) + alignment - 1) & ~(alignment - 1));
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                block->ptr = AllocBlock(block_size_);
+            }
+            block->end = block->ptr + block_size_;
+            aligned = (reinterpret_cast<uintptr_t>(block->ptr) + alignment - 1) & ~(alignment - 1);
+        }
+        uint8_t *result = reinterpret_cast<uint8_t *>(aligned);
+        block->bytes_used.store(block->bytes_used.load(std::memory_order_relaxed) + (result + bytes - block->ptr),
+                                std::memory_order_relaxed);
+        block->ptr = result + bytes;
+        return result;
+    }
+
+    size_t ArenaAllocator::BytesAllocated() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        return bytes_allocated_;
+    }
+
+    size_t ArenaAllocator::BytesUsed() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        size_t bytes_used = 0;
+        for (const auto &entry : thread_blocks_) {
+            bytes_used += entry.second->bytes_used.load(std::memory_order_relaxed);
+        }
+        return bytes_used;
+    }
+
+    size_t ArenaAllocator::NumBlocks() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        return blocks_.size();
+    }
+
+    uint8_t *ArenaAllocator::AllocBlock(size_t size) {
+        uint8_t *block = reinterpret_cast<uint8_t *>(malloc(size));
+        CHECK(block != nullptr) << "arena block allocation of " << size << " bytes failed";
+        blocks_.push_back(block);
+        bytes_allocated_ += size;
+        return block;
+    }
+
+}  // namespace base
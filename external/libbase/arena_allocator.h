@@ -0,0 +1,87 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_ARENA_ALLOCATOR_H
+#define BASE_ARENA_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "macros.h"
+
+namespace base {
+
+// Bump pointer allocator. Memory is handed out from large blocks and only returned to the system
+// when the allocator is destroyed, so objects placed in it must be destroyed by their owner (see
+// ArenaDelete) but never freed one by one. Alloc is thread safe: every thread bumps through a block
+// of its own and only takes the lock to get a new one.
+    class ArenaAllocator {
+    public:
+        static constexpr size_t kDefaultBlockSize = 256 * 1024;
+
+        explicit ArenaAllocator(size_t block_size = kDefaultBlockSize);
+
+        ~ArenaAllocator();
+
+        void *Alloc(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+        template<class T, class... Args>
+        T *New(Args &&... args) {
+            return new(Alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Bytes reserved from the system.
+        size_t BytesAllocated() const;
+
+        // Bytes handed out to callers, including alignment padding.
+        size_t BytesUsed() const;
+
+        size_t NumBlocks() const;
+
+    private:
+        // The part of a block a thread allocates from.
+        struct ThreadBlock {
+            uint8_t *ptr = nullptr;
+            uint8_t *end = nullptr;
+            // Only written by the owning thread, atomic so the stats can be read at any time.
+            std::atomic<size_t> bytes_used{0};
+        };
+
+        ThreadBlock *CurrentThreadBlock();
+
+        uint8_t *AllocBlock(size_t size);
+
+        const size_t block_size_;
+        // Tells arenas apart in the per-thread cache, unlike addresses ids are never reused.
+        const uint64_t id_;
+        std::vector<uint8_t *> blocks_;
+        std::map<std::thread::id, std::unique_ptr<ThreadBlock>> thread_blocks_;
+        size_t bytes_allocated_ = 0;
+        mutable std::mutex lock_;
+
+        DISALLOW_COPY_AND_ASSIGN(ArenaAllocator);
+    };
+
+// Deleter for objects created with ArenaAllocator::New: runs the destructor and leaves the memory
+// to the arena.
+    template<class T>
+    struct ArenaDelete {
+        void operator()(T *ptr) const {
+            ptr->~T();
+        }
+    };
+
+}  // namespace base
+
+#endif //BASE_ARENA_ALLOCATOR_H
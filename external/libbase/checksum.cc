@@ -0,0 +1,280 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include "checksum.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define BASE_SHA1_X86 1
+#endif
+
+namespace base {
+
+    namespace {
+        constexpr uint32_t kAdler32Base = 65521u;
+        // Largest n such that 255n(n+1)/2 + (n+1)(kAdler32Base-1) fits in 32 bits.
+        constexpr size_t kAdler32Nmax = 5552u;
+        constexpr size_t kAdler32Lanes = 16u;
+        static_assert(kAdler32Nmax % kAdler32Lanes == 0, "Block must hold whole rows of lanes");
+
+        inline uint32_t RotateLeft(uint32_t value, int shift) {
+            return (value << shift) | (value >> (32 - shift));
+        }
+
+        inline uint32_t LoadBigEndian32(const uint8_t *data) {
+            return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+                   (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+        }
+
+        inline void StoreBigEndian32(uint32_t value, uint8_t *data) {
+            data[0] = static_cast<uint8_t>(value >> 24);
+            data[1] = static_cast<uint8_t>(value >> 16);
+            data[2] = static_cast<uint8_t>(value >> 8);
+            data[3] = static_cast<uint8_t>(value);
+        }
+
+        void Sha1BlocksPortable(uint32_t state[5], const uint8_t *data, size_t count) {
+            for (; count != 0; --count, data += 64) {
+                uint32_t w[80];
+                for (size_t i = 0; i < 16; ++i) {
+                    w[i] = LoadBigEndian32(data + i * 4);
+                }
+                for (size_t i = 16; i < 80; ++i) {
+                    w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+                }
+                uint32_t a = state[0];
+                uint32_t b = state[1];
+                uint32_t c = state[2];
+                uint32_t d = state[3];
+                uint32_t e = state[4];
+                // One loop per round function keeps the rounds free of branches so they can be unrolled.
+#define SHA1_ROUND(f, k, i)                                                    \
+                do {                                                           \
+                    const uint32_t temp = RotateLeft(a, 5) + (f) + e + (k) + w[i]; \
+                    e = d;                                                     \
+                    d = c;                                                     \
+                    c = RotateLeft(b, 30);                                     \
+                    b = a;                                                     \
+                    a = temp;                                                  \
+                } while (false)
+                for (size_t i = 0; i < 20; ++i) {
+                    SHA1_ROUND(d ^ (b & (c ^ d)), 0x5a827999u, i);
+                }
+                for (size_t i = 20; i < 40; ++i) {
+                    SHA1_ROUND(b ^ c ^ d, 0x6ed9eba1u, i);
+                }
+                for (size_t i = 40; i < 60; ++i) {
+                    SHA1_ROUND((b & c) | (d & (b | c)), 0x8f1bbcdcu, i);
+                }
+                for (size_t i = 60; i < 80; ++i) {
+                    SHA1_ROUND(b ^ c ^ d, 0xca62c1d6u, i);
+                }
+#undef SHA1_ROUND
+                state[0] += a;
+                state[1] += b;
+                state[2] += c;
+                state[3] += d;
+                state[4] += e;
+            }
+        }
+
+#ifdef BASE_SHA1_X86
+        bool HasShaExtensions() {
+            unsigned int eax, ebx, ecx, edx;
+            if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & bit_SSSE3) == 0 || (ecx & bit_SSE4_1) == 0) {
+                return false;
+            }
+            return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA) != 0;
+        }
+
+        // Four rounds per sha1rnds4. The message words for rounds 4g..4g+3 sit in msg[g % 4] and the
+        // schedule for the following groups is advanced alongside; the E values alternate between
+        // e[0] and e[1].
+#define SHA1_GROUP(g)                                                                  \
+        do {                                                                           \
+            e[(g) & 1] = _mm_sha1nexte_epu32(e[(g) & 1], msg[(g) & 3]);                \
+            e[((g) + 1) & 1] = abcd;                                                   \
+            msg[((g) + 1) & 3] = _mm_sha1msg2_epu32(msg[((g) + 1) & 3], msg[(g) & 3]); \
+            abcd = _mm_sha1rnds4_epu32(abcd, e[(g) & 1], (g) / 5);                      \
+            msg[((g) + 3) & 3] = _mm_sha1msg1_epu32(msg[((g) + 3) & 3], msg[(g) & 3]); \
+            msg[((g) + 2) & 3] = _mm_xor_si128(msg[((g) + 2) & 3], msg[(g) & 3]);      \
+        } while (false)
+
+        __attribute__((target("sha,sse4.1,ssse3")))
+        void Sha1BlocksShaExtensions(uint32_t state[5], const uint8_t *data, size_t count) {
+            const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+            __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1b);
+            __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+            for (; count != 0; --count, data += 64) {
+                const __m128i abcd_save = abcd;
+                const __m128i e0_save = e0;
+                __m128i msg[4];
+                __m128i e[2];
+                for (size_t i = 0; i < 4; ++i) {
+                    msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 16)),
+                                              byte_swap);
+                }
+                // The first groups only start the message schedule.
+                e[0] = _mm_add_epi32(e0, msg[0]);
+                e[1] = abcd;
+                abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+
+                e[1] = _mm_sha1nexte_epu32(e[1], msg[1]);
+                e[0] = abcd;
+                abcd = _mm_sha1rnds4_epu32(abcd, e[1], 0);
+                msg[0] = _mm_sha1msg1_epu32(msg[0], msg[1]);
+
+                e[0] = _mm_sha1nexte_epu32(e[0], msg[2]);
+                e[1] = abcd;
+                abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+                msg[1] = _mm_sha1msg1_epu32(msg[1], msg[2]);
+                msg[0] = _mm_xor_si128(msg[0], msg[2]);
+
+                SHA1_GROUP(3);
+                SHA1_GROUP(4);
+                SHA1_GROUP(5);
+                SHA1_GROUP(6);
+                SHA1_GROUP(7);
+                SHA1_GROUP(8);
+                SHA1_GROUP(9);
+                SHA1_GROUP(10);
+                SHA1_GROUP(11);
+                SHA1_GROUP(12);
+                SHA1_GROUP(13);
+                SHA1_GROUP(14);
+                SHA1_GROUP(15);
+                SHA1_GROUP(16);
+                SHA1_GROUP(17);
+                SHA1_GROUP(18);
+                SHA1_GROUP(19);
+
+                e0 = _mm_sha1nexte_epu32(e[0], e0_save);
+                abcd = _mm_add_epi32(abcd, abcd_save);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_shuffle_epi32(abcd, 0x1b));
+            state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+        }
+
+#undef SHA1_GROUP
+#endif
+    }
+
+    uint32_t Adler32(uint32_t adler, const uint8_t *data, size_t size) {
+        uint64_t s1 = adler & 0xffff;
+        uint64_t s2 = adler >> 16;
+        // Sum every block in kAdler32Lanes independent lanes so the inner loop vectorizes, then fold
+        // the lanes back: byte j of a row of a block of n bytes is counted n - row * lanes - j times
+        // in s2, which is lanes times its count in the lane's running sum minus j.
+        while (size >= kAdler32Lanes) {
+            const size_t n = std::min(size, kAdler32Nmax) & ~(kAdler32Lanes - 1);
+            uint32_t a[kAdler32Lanes] = {};
+            uint32_t b[kAdler32Lanes] = {};
+            for (size_t i = 0; i < n; i += kAdler32Lanes) {
+                for (size_t j = 0; j < kAdler32Lanes; ++j) {
+                    a[j] += data[i + j];
+                    b[j] += a[j];
+                }
+            }
+            uint64_t sum_a = 0u;
+            uint64_t sum_b = 0u;
+            uint64_t sum_ja = 0u;
+            for (size_t j = 0; j < kAdler32Lanes; ++j) {
+                sum_a += a[j];
+                sum_b += b[j];
+                sum_ja += j * a[j];
+            }
+            s2 = (s2 + n * s1 + kAdler32Lanes * sum_b - sum_ja) % kAdler32Base;
+            s1 = (s1 + sum_a) % kAdler32Base;
+            data += n;
+            size -= n;
+        }
+        while (size-- != 0) {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= kAdler32Base;
+        s2 %= kAdler32Base;
+        return static_cast<uint32_t>(s1 | (s2 << 16));
+    }
+
+    uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, uint64_t size2) {
+        const uint32_t rem = static_cast<uint32_t>(size2 % kAdler32Base);
+        uint64_t sum1 = adler1 & 0xffff;
+        uint64_t sum2 = (rem * sum1) % kAdler32Base;
+        sum1 += (adler2 & 0xffff) + kAdler32Base - 1;
+        sum2 += (adler1 >> 16) + (adler2 >> 16) + kAdler32Base - rem;
+        sum1 %= kAdler32Base;
+        sum2 %= kAdler32Base;
+        return static_cast<uint32_t>(sum1 | (sum2 << 16));
+    }
+
+    uint32_t Adler32Replace(uint32_t adler, uint32_t old_adler, uint32_t new_adler, uint64_t size_after) {
+        // Combining is linear in the sums of the middle part: its first sum moves the first sum of the
+        // range and, once per byte after it, the second sum.
+        const uint64_t delta1 = ((new_adler & 0xffff) + kAdler32Base - (old_adler & 0xffff)) % kAdler32Base;
+        const uint64_t delta2 = ((new_adler >> 16) + kAdler32Base - (old_adler >> 16)) % kAdler32Base;
+        const uint64_t sum1 = ((adler & 0xffff) + delta1) % kAdler32Base;
+        const uint64_t sum2 = ((adler >> 16) + delta2 + (size_after % kAdler32Base) * delta1) % kAdler32Base;
+        return static_cast<uint32_t>(sum1 | (sum2 << 16));
+    }
+
+    Sha1::Sha1() : state_{0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u, 0xc3d2e1f0u} {}
+
+    void Sha1::Update(const uint8_t *data, size_t size) {
+        length_ += size;
+        if (buffer_size_ != 0) {
+            const size_t count = std::min(size, kBlockSize - buffer_size_);
+            memcpy(buffer_ + buffer_size_, data, count);
+            buffer_size_ += count;
+            data += count;
+            size -= count;
+            if (buffer_size_ < kBlockSize) {
+                return;
+            }
+            ProcessBlocks(buffer_, 1u);
+            buffer_size_ = 0u;
+        }
+        const size_t count = size / kBlockSize;
+        if (count != 0) {
+            ProcessBlocks(data, count);
+            data += count * kBlockSize;
+            size -= count * kBlockSize;
+        }
+        memcpy(buffer_, data, size);
+        buffer_size_ = size;
+    }
+
+    void Sha1::Finish(uint8_t digest[kDigestSize]) {
+        const uint64_t bit_length = length_ * 8;
+        buffer_[buffer_size_++] = 0x80;
+        if (buffer_size_ > kBlockSize - sizeof(bit_length)) {
+            memset(buffer_ + buffer_size_, 0, kBlockSize - buffer_size_);
+            ProcessBlocks(buffer_, 1u);
+            buffer_size_ = 0u;
+        }
+        memset(buffer_ + buffer_size_, 0, kBlockSize - sizeof(bit_length) - buffer_size_);
+        StoreBigEndian32(static_cast<uint32_t>(bit_length >> 32), buffer_ + kBlockSize - 8);
+        StoreBigEndian32(static_cast<uint32_t>(bit_length), buffer_ + kBlockSize - 4);
+        ProcessBlocks(buffer_, 1u);
+        for (size_t i = 0; i < 5; ++i) {
+            StoreBigEndian32(state_[i], digest + i * 4);
+        }
+    }
+
+    void Sha1::ProcessBlocks(const uint8_t *data, size_t count) {
+#ifdef BASE_SHA1_X86
+        static const bool has_sha_extensions = HasShaExtensions();
+        if (has_sha_extensions) {
+            Sha1BlocksShaExtensions(state_, data, count);
+            return;
+        }
+#endif
+        Sha1BlocksPortable(state_, data, count);
+    }
+}
@@ -0,0 +1,56 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_CHECKSUM_H
+#define BASE_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "macros.h"
+
+namespace base {
+
+    // Initial value of an Adler-32 checksum.
+    static constexpr uint32_t kAdler32Init = 1u;
+
+    // Adler-32 of |data| continued from |adler|, same result as zlib adler32().
+    uint32_t Adler32(uint32_t adler, const uint8_t *data, size_t size);
+
+    // Adler-32 of the concatenation of two ranges given the checksum of each and the size of the
+    // second one, same result as zlib adler32_combine().
+    uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, uint64_t size2);
+
+    // Adler-32 of a range after a part of it, followed by |size_after| more bytes, was replaced by
+    // content of the same size. |old_adler| and |new_adler| are the checksums of the part before and
+    // after the change on their own, so the rest of the range is never read.
+    uint32_t Adler32Replace(uint32_t adler, uint32_t old_adler, uint32_t new_adler, uint64_t size_after);
+
+    // Incremental SHA-1.
+    class Sha1 {
+    public:
+        static constexpr size_t kDigestSize = 20;
+
+        Sha1();
+
+        void Update(const uint8_t *data, size_t size);
+
+        // Writes the digest of everything passed to Update. The object must not be used afterwards.
+        void Finish(uint8_t digest[kDigestSize]);
+
+    private:
+        static constexpr size_t kBlockSize = 64;
+
+        void ProcessBlocks(const uint8_t *data, size_t count);
+
+        uint32_t state_[5];
+        uint64_t length_ = 0u;
+        uint8_t buffer_[kBlockSize];
+        size_t buffer_size_ = 0u;
+
+        DISALLOW_COPY_AND_ASSIGN(Sha1);
+    };
+}
+
+#endif //BASE_CHECKSUM_H
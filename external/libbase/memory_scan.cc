@@ -6,7 +6,15 @@
 #include <pthread.h>
 #include <assert.h>
 #include <string.h>
+#include <algorithm>
+#include <memory>
 #include "memory_scan.h"
+#include "stringprintf.h"
+#include "thread_pool.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 std::vector<std::string> MemoryScan::string_split(std::string string, std::string delimiter, int max_tokens) {
@@ -468,3 +476,283 @@ uint8_t *MemoryScan::memoryScanOnce(void *base_, void *end) {
 MemoryScan::MatchToken::~MatchToken() {
     //std::cout << "delete MatchToken" << std::endl;
 }
+
+namespace {
+    struct AnchorShape {
+        size_t width;
+        size_t stride;
+        size_t key_bits;
+    };
+
+    // Every stride consecutive windows of an anchor of width + stride - 1 exact bytes are keyed, one of
+    // them is at a probed position whatever the alignment. The last shape anchors on a single byte of
+    // any mask, expanded to all the values it matches.
+    constexpr AnchorShape kAnchorShapes[] = {{4, 5, 16}, {2, 3, 16}, {2, 1, 16}, {1, 1, 8}};
+
+    int HexDigitValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Same syntax as MemoryScan: pairs of hex digits where '?' leaves a nibble free, optionally
+    // followed by ':' and one mask byte per pattern byte. Spaces are ignored.
+    bool ParseScanPattern(const std::string &str, std::vector<uint8_t> *bytes, std::vector<uint8_t> *masks,
+                          std::string *error_msg) {
+        std::string digits[2];
+        size_t part = 0;
+        for (char c : str) {
+            if (c == ':' && part == 0) {
+                part = 1;
+            } else if (c != ' ') {
+                digits[part].push_back(c);
+            }
+        }
+        const std::string &match = digits[0];
+        const std::string &mask = digits[1];
+        if (match.empty() || match.size() % 2 != 0 || (part == 1 && mask.size() != match.size())) {
+            *error_msg = base::StringPrintf("Malformed scan pattern \"%s\"", str.c_str());
+            return false;
+        }
+        for (size_t i = 0; i < match.size(); i += 2) {
+            int byte_mask = 0xff;
+            if (part == 1) {
+                int upper = HexDigitValue(mask[i]);
+                int lower = HexDigitValue(mask[i + 1]);
+                if (upper == -1 || lower == -1) {
+                    *error_msg = base::StringPrintf("Bad mask in scan pattern \"%s\"", str.c_str());
+                    return false;
+                }
+                byte_mask = (upper << 4) | lower;
+            }
+            int upper = match[i] == '?' ? 0 : HexDigitValue(match[i]);
+            int lower = match[i + 1] == '?' ? 0 : HexDigitValue(match[i + 1]);
+            if (upper == -1 || lower == -1) {
+                *error_msg = base::StringPrintf("Bad byte in scan pattern \"%s\"", str.c_str());
+                return false;
+            }
+            if (match[i] == '?') byte_mask &= 0x0f;
+            if (match[i + 1] == '?') byte_mask &= 0xf0;
+            bytes->push_back(static_cast<uint8_t>(((upper << 4) | lower) & byte_mask));
+            masks->push_back(static_cast<uint8_t>(byte_mask));
+        }
+        return true;
+    }
+
+    // 00 and ff fill most of memory, anchors made of other bytes let fewer positions through.
+    size_t AnchorScore(const uint8_t *bytes, size_t width) {
+        size_t score = 0;
+        for (size_t i = 0; i < width; ++i) {
+            score += bytes[i] != 0x00 && bytes[i] != 0xff;
+        }
+        return score;
+    }
+
+    template<size_t kWidth>
+    inline uint32_t LoadAnchor(const uint8_t *data) {
+        uint32_t value = 0;
+        memcpy(&value, data, kWidth);
+        return value;
+    }
+
+    template<size_t kWidth>
+    inline uint32_t AnchorKey(uint32_t value) {
+        return kWidth == 4 ? (value * 0x9e3779b1u) >> 16 : value;
+    }
+
+    inline bool MatchMasked(const uint8_t *data, const uint8_t *bytes, const uint8_t *masks, size_t size) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 16 <= size; i += 16) {
+            __m128i value = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks + i)));
+            __m128i expected = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(value, expected)) != 0xffff) {
+                return false;
+            }
+        }
+#endif
+        for (; i < size; ++i) {
+            if ((data[i] & masks[i]) != bytes[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+MultiMemoryScan *MultiMemoryScan::Create(const std::vector<std::string> &patterns, std::string *error_msg) {
+    static_assert(sizeof(kAnchorShapes) / sizeof(kAnchorShapes[0]) == kNumAnchorTables, "One shape per table");
+    std::unique_ptr<MultiMemoryScan> scan(new MultiMemoryScan());
+    std::vector<std::pair<uint32_t, Anchor>> keyed[kNumAnchorTables];
+    for (size_t index = 0; index < patterns.size(); ++index) {
+        Pattern pattern;
+        if (!ParseScanPattern(patterns[index], &pattern.bytes, &pattern.masks, error_msg)) {
+            return nullptr;
+        }
+        const uint8_t *bytes = pattern.bytes.data();
+        const uint8_t *masks = pattern.masks.data();
+        size_t size = pattern.bytes.size();
+        bool anchored = false;
+        // The first shape the pattern has a run of exact bytes for, on the least common looking run.
+        for (size_t table = 0; table + 1 < kNumAnchorTables && !anchored; ++table) {
+            const AnchorShape &shape = kAnchorShapes[table];
+            size_t span = shape.width + shape.stride - 1;
+            size_t best = size;
+            size_t best_score = 0;
+            size_t run = 0;
+            for (size_t i = 0; i < size; ++i) {
+                run = masks[i] == 0xff ? run + 1 : 0;
+                if (run >= span) {
+                    size_t score = AnchorScore(bytes + i + 1 - span, span);
+                    if (best == size || score > best_score) {
+                        best = i + 1 - span;
+                        best_score = score;
+                    }
+                }
+            }
+            if (best == size) {
+                continue;
+            }
+            for (size_t offset = best; offset < best + shape.stride; ++offset) {
+                uint32_t value = shape.width == 4 ? LoadAnchor<4>(bytes + offset) : LoadAnchor<2>(bytes + offset);
+                uint32_t key = shape.width == 4 ? AnchorKey<4>(value) : AnchorKey<2>(value);
+                keyed[table].push_back(
+                        {key, {static_cast<uint32_t>(index), static_cast<uint32_t>(offset), value}});
+            }
+            anchored = true;
+        }
+        if (!anchored) {
+            // A single byte, every value it may take gets an anchor.
+            size_t best = 0;
+            for (size_t i = 1; i < size; ++i) {
+                if (__builtin_popcount(masks[i]) > __builtin_popcount(masks[best])) {
+                    best = i;
+                }
+            }
+            if (masks[best] == 0) {
+                *error_msg = base::StringPrintf("Scan pattern \"%s\" matches anything", patterns[index].c_str());
+                return nullptr;
+            }
+            for (uint32_t value = 0; value < 256; ++value) {
+                if ((value & masks[best]) == bytes[best]) {
+                    keyed[kNumAnchorTables - 1].push_back(
+                            {value, {static_cast<uint32_t>(index), static_cast<uint32_t>(best), value}});
+                }
+            }
+        }
+        scan->patterns_.push_back(std::move(pattern));
+    }
+    for (size_t table = 0; table < kNumAnchorTables; ++table) {
+        if (keyed[table].empty()) {
+            continue;
+        }
+        AnchorTable &anchors = scan->tables_[table];
+        anchors.width = kAnchorShapes[table].width;
+        anchors.stride = kAnchorShapes[table].stride;
+        size_t num_keys = size_t(1) << kAnchorShapes[table].key_bits;
+        std::stable_sort(keyed[table].begin(), keyed[table].end(),
+                         [](const std::pair<uint32_t, Anchor> &a, const std::pair<uint32_t, Anchor> &b) {
+                             return a.first < b.first;
+                         });
+        anchors.filter.assign((num_keys + 63) / 64, 0u);
+        anchors.offsets.assign(num_keys + 1, 0u);
+        for (const auto &entry : keyed[table]) {
+            anchors.filter[entry.first >> 6] |= uint64_t(1) << (entry.first & 63);
+            anchors.offsets[entry.first + 1]++;
+            anchors.anchors.push_back(entry.second);
+            anchors.max_offset = std::max<size_t>(anchors.max_offset, entry.second.offset);
+        }
+        for (size_t key = 0; key < num_keys; ++key) {
+            anchors.offsets[key + 1] += anchors.offsets[key];
+        }
+    }
+    return scan.release();
+}
+
+template<size_t kWidth>
+void MultiMemoryScan::ScanTable(const AnchorTable &table, const uint8_t *chunk_begin, const uint8_t *chunk_end,
+                                const uint8_t *end, std::vector<Match> *matches) const {
+    if (table.anchors.empty() || static_cast<size_t>(end - chunk_begin) < kWidth) {
+        return;
+    }
+    // A match starting before chunk_end may have its anchor up to max_offset bytes after it.
+    const uint8_t *scan_end = end - kWidth + 1;
+    if (scan_end > chunk_end && static_cast<size_t>(scan_end - chunk_end) > table.max_offset) {
+        scan_end = chunk_end + table.max_offset;
+    }
+    const uint64_t *filter = table.filter.data();
+    for (const uint8_t *data = chunk_begin; data < scan_end; data += table.stride) {
+        uint32_t value = LoadAnchor<kWidth>(data);
+        uint32_t key = AnchorKey<kWidth>(value);
+        if ((filter[key >> 6] & (uint64_t(1) << (key & 63))) == 0) {
+            continue;
+        }
+        for (uint32_t i = table.offsets[key]; i < table.offsets[key + 1]; ++i) {
+            const Anchor &anchor = table.anchors[i];
+            if (anchor.value != value || static_cast<size_t>(data - chunk_begin) < anchor.offset) {
+                continue;
+            }
+            const uint8_t *start = data - anchor.offset;
+            const Pattern &pattern = patterns_[anchor.pattern];
+            if (start >= chunk_end || static_cast<size_t>(end - start) < pattern.bytes.size() ||
+                !MatchMasked(start, pattern.bytes.data(), pattern.masks.data(), pattern.bytes.size())) {
+                continue;
+            }
+            matches->push_back({const_cast<uint8_t *>(start), anchor.pattern});
+        }
+    }
+}
+
+void MultiMemoryScan::ScanChunk(const uint8_t *chunk_begin, const uint8_t *chunk_end, const uint8_t *end,
+                                std::vector<Match> *matches) const {
+    for (const AnchorTable &table : tables_) {
+        if (table.width == 4) {
+            ScanTable<4>(table, chunk_begin, chunk_end, end, matches);
+        } else if (table.width == 2) {
+            ScanTable<2>(table, chunk_begin, chunk_end, end, matches);
+        } else if (table.width == 1) {
+            ScanTable<1>(table, chunk_begin, chunk_end, end, matches);
+        }
+    }
+    auto less = [](const Match &a, const Match &b) {
+        return a.address != b.address ? a.address < b.address : a.pattern < b.pattern;
+    };
+    if (!std::is_sorted(matches->begin(), matches->end(), less)) {
+        std::sort(matches->begin(), matches->end(), less);
+    }
+}
+
+bool MultiMemoryScan::Scan(const void *base, size_t len, const BatchCallback &callback,
+                           base::ThreadPool *thread_pool) const {
+    const uint8_t *begin = static_cast<const uint8_t *>(base);
+    const uint8_t *end = begin + len;
+    size_t num_chunks = (len + kChunkSize - 1) / kChunkSize;
+    // A few chunks per thread at a time, so that a callback stopping early does not wait for the
+    // whole range and the pending matches stay bounded.
+    size_t wave_size = thread_pool == nullptr ? 1u : thread_pool->GetThreadCount() * 4;
+    std::vector<std::vector<Match>> results(std::min(wave_size, num_chunks));
+    for (size_t first = 0; first < num_chunks; first += wave_size) {
+        size_t count = std::min(wave_size, num_chunks - first);
+        auto scan_chunk = [&](size_t i) {
+            const uint8_t *chunk_begin = begin + (first + i) * kChunkSize;
+            const uint8_t *chunk_end = chunk_begin + std::min<size_t>(kChunkSize, end - chunk_begin);
+            results[i].clear();
+            ScanChunk(chunk_begin, chunk_end, end, &results[i]);
+        };
+        if (thread_pool != nullptr) {
+            thread_pool->ParallelFor(count, scan_chunk);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                scan_chunk(i);
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!results[i].empty() && !callback(results[i].data(), results[i].size())) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
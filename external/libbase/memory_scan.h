@@ -10,6 +10,11 @@
 #include <functional>
 #include <stdint.h>
 #include <sys/types.h>
+
+namespace base {
+    class ThreadPool;
+}
+
 class MemoryScan {
 public:
 
@@ -91,5 +96,73 @@ private:
 
 };
 
+// Scans for a whole set of MemoryScan patterns in one pass. Every pattern is anchored on a few of its
+// fixed bytes: a run of exact bytes when it has one, else its most constrained byte. A bitmap keyed
+// by the anchors rejects almost every probed position with one load, the rest is checked against the
+// full pattern and its masks. Long anchors leave several windows to the bitmap, so only one position
+// out of a few needs a probe.
+class MultiMemoryScan {
+public:
+    struct Match {
+        uint8_t *address;
+        uint32_t pattern;  // Index of the pattern in the list given to Create().
+    };
+
+    // Receives the matches of consecutive parts of the scanned range, sorted by address then pattern.
+    // Returning false stops the scan.
+    typedef std::function<bool(const Match *matches, size_t count)> BatchCallback;
+
+    // Patterns use the MemoryScan syntax, e.g. "48 8b ?? 0? 05" or "48 8b 05:ff f0 ff". Returns
+    // nullptr and sets |error_msg| when a pattern is malformed or does not fix a single bit.
+    static MultiMemoryScan *Create(const std::vector<std::string> &patterns, std::string *error_msg);
+
+    // Scans [base, base + len). The range is cut into chunks, run on |thread_pool| when one is given.
+    // A match is reported by the chunk it starts in, even when it ends in the next one. Returns false
+    // when the callback stopped the scan.
+    bool Scan(const void *base, size_t len, const BatchCallback &callback,
+              base::ThreadPool *thread_pool = nullptr) const;
+
+    size_t NumPatterns() const { return patterns_.size(); }
+
+private:
+    static constexpr size_t kChunkSize = 1u << 20;
+
+    struct Pattern {
+        std::vector<uint8_t> bytes;  // Already masked.
+        std::vector<uint8_t> masks;
+    };
+
+    // Window of an anchor, matched against the |width| bytes at a probed position.
+    struct Anchor {
+        uint32_t pattern;
+        uint32_t offset;  // Of the window in the pattern.
+        uint32_t value;   // The window bytes as loaded from memory.
+    };
+
+    // Windows of |width| bytes probed every |stride| positions, grouped by key.
+    struct AnchorTable {
+        size_t width = 0;
+        size_t stride = 0;
+        std::vector<uint64_t> filter;  // One bit per key.
+        std::vector<uint32_t> offsets;
+        std::vector<Anchor> anchors;
+        size_t max_offset = 0;
+    };
+
+    static constexpr size_t kNumAnchorTables = 4;
+
+    MultiMemoryScan() = default;
+
+    void ScanChunk(const uint8_t *chunk_begin, const uint8_t *chunk_end, const uint8_t *end,
+                   std::vector<Match> *matches) const;
+
+    template<size_t kWidth>
+    void ScanTable(const AnchorTable &table, const uint8_t *chunk_begin, const uint8_t *chunk_end,
+                   const uint8_t *end, std::vector<Match> *matches) const;
+
+    std::vector<Pattern> patterns_;
+    AnchorTable tables_[kNumAnchorTables];
+};
+
 
 #endif //STRSPLT_MEMORYSCAN_H
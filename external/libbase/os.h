@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <string>
+
 namespace base {
     class FdFile;
 }  // namespace unix_file
@@ -45,6 +47,10 @@ namespace base {
         // already exists, it is *not* overwritten, but unlinked, and a new inode will be used.
         static File *CreateEmptyFileWriteOnly(const char *name);
 
+        // Create a new file with read/write access and a unique name made from |name|, so that
+        // several writers of the same output do not share it. The name is stored in |temp_name|.
+        static File *CreateTempFileNextTo(const char *name, std::string *temp_name);
+
         // Open a file with the specified open(2) flags.
         static File *OpenFileWithFlags(const char *name, int flags, bool auto_flush = true);
 
@@ -17,6 +17,7 @@
 #include "os.h"
 
 #include <fcntl.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -53,6 +54,19 @@ namespace base {
         return base::CreateEmptyFile(name, O_WRONLY | O_TRUNC);
     }
 
+    File *OS::CreateTempFileNextTo(const char *name, std::string *temp_name) {
+        CHECK(name != nullptr);
+        std::string path = std::string(name) + ".XXXXXX";
+        int fd = mkstemp(&path[0]);
+        if (fd == -1) {
+            return nullptr;
+        }
+        // mkstemp creates the file 0600, use the mode of the files created above.
+        fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        *temp_name = path;
+        return new File(fd, path, /*check_usage=*/ true);
+    }
+
     File *OS::OpenFileWithFlags(const char *name, int flags, bool auto_flush) {
         CHECK(name != nullptr);
         bool read_only = ((flags & O_ACCMODE) == O_RDONLY);
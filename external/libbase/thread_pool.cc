@@ -0,0 +1,139 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "thread_pool.h"
+
+namespace base {
+
+    ThreadPool::ThreadPool(size_t thread_count) {
+        if (thread_count > 1) {
+            workers_.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; ++i) {
+                workers_.emplace_back(&ThreadPool::Run, this);
+            }
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            shutdown_ = true;
+        }
+        task_cond_.notify_all();
+        for (std::thread &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::AddTask(std::function<void()> task) {
+        if (workers_.empty()) {
+            task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            tasks_.push_back(std::move(task));
+        }
+        task_cond_.notify_one();
+    }
+
+    void ThreadPool::Wait() {
+        std::unique_lock<std::mutex> guard(lock_);
+        done_cond_.wait(guard, [this] { return tasks_.empty() && running_ == 0; });
+    }
+
+    void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t index)> &func) {
+        ParallelForRange(count, 1u, [&func](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                func(i);
+            }
+        });
+    }
+
+    void ThreadPool::ParallelForRange(size_t count,
+                                      size_t min_chunk_size,
+                                      const std::function<void(size_t begin, size_t end)> &func) {
+        if (count == 0) {
+            return;
+        }
+        if (workers_.empty()) {
+            func(0, count);
+            return;
+        }
+        // A few chunks per worker so that a slow chunk does not leave the other workers idle.
+        size_t chunk_size = std::max<size_t>(std::max<size_t>(min_chunk_size, 1u),
+                                             count / (workers_.size() * 4));
+        size_t num_chunks = (count + chunk_size - 1) / chunk_size;
+
+        // Chunks are claimed from a counter owned by this call, and the calling thread claims them
+        // too. Completion is tracked per call, so a call made from inside a task neither waits for
+        // unrelated work nor deadlocks when every worker is busy. Helpers that only start after the
+        // call returned find no chunk left and never touch func.
+        struct Batch {
+            std::atomic<size_t> next{0};
+            size_t done = 0;
+            std::mutex lock;
+            std::condition_variable done_cond;
+        };
+        std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+        auto run_chunks = [batch, &func, count, chunk_size, num_chunks] {
+            size_t finished = 0;
+            for (;;) {
+                size_t chunk = batch->next.fetch_add(1u);
+                if (chunk >= num_chunks) {
+                    break;
+                }
+                size_t begin = chunk * chunk_size;
+                func(begin, std::min(count, begin + chunk_size));
+                ++finished;
+            }
+            if (finished != 0u) {
+                std::lock_guard<std::mutex> guard(batch->lock);
+                batch->done += finished;
+                if (batch->done == num_chunks) {
+                    batch->done_cond.notify_all();
+                }
+            }
+        };
+        size_t num_helpers = std::min(workers_.size(), num_chunks - 1u);
+        for (size_t i = 0; i < num_helpers; ++i) {
+            AddTask(run_chunks);
+        }
+        run_chunks();
+        std::unique_lock<std::mutex> guard(batch->lock);
+        batch->done_cond.wait(guard, [&batch, num_chunks] { return batch->done == num_chunks; });
+    }
+
+    size_t ThreadPool::DefaultThreadCount() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void ThreadPool::Run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(lock_);
+                task_cond_.wait(guard, [this] { return shutdown_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+                ++running_;
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                --running_;
+                if (tasks_.empty() && running_ == 0) {
+                    done_cond_.notify_all();
+                }
+            }
+        }
+    }
+
+}  // namespace base
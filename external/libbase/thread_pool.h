@@ -0,0 +1,70 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_THREAD_POOL_H
+#define BASE_THREAD_POOL_H
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "macros.h"
+
+namespace base {
+
+// Fixed size pool of worker threads. A pool created with zero or one thread does not spawn any
+// worker and runs every task on the calling thread, so callers can use the same code path for
+// serial and parallel runs.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t thread_count);
+
+        ~ThreadPool();
+
+        // Number of threads used to run tasks, the calling thread counts as one when no worker exists.
+        size_t GetThreadCount() const {
+            return workers_.empty() ? 1u : workers_.size();
+        }
+
+        // Queue a task. Tasks may run in any order and on any worker.
+        void AddTask(std::function<void()> task);
+
+        // Block until every queued task has finished, including tasks queued by other callers.
+        void Wait();
+
+        // Call func(i) for every i in [0, count) and wait for completion. The range is cut into
+        // contiguous chunks that the workers and the calling thread pick up one at a time. Only the
+        // chunks of this call are waited for, so it may be called from inside a task of the pool.
+        void ParallelFor(size_t count, const std::function<void(size_t index)> &func);
+
+        // Same as above but hands out whole chunks: func(begin, end) covers [begin, end).
+        void ParallelForRange(size_t count,
+                              size_t min_chunk_size,
+                              const std::function<void(size_t begin, size_t end)> &func);
+
+        // The number of threads to use when the caller does not care.
+        static size_t DefaultThreadCount();
+
+    private:
+        void Run();
+
+        std::vector<std::thread> workers_;
+        std::deque<std::function<void()>> tasks_;
+        std::mutex lock_;
+        std::condition_variable task_cond_;
+        std::condition_variable done_cond_;
+        size_t running_ = 0;
+        bool shutdown_ = false;
+
+        DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+    };
+
+}  // namespace base
+
+#endif //BASE_THREAD_POOL_H
@@ -79,13 +79,35 @@ namespace dex_ir {
                 string_datas_map_.CreateAndAddItem(header_->StringDatas(),
                                                    eagerly_assign_offsets_,
                                                    disk_string_id.string_data_off_,
-                                                   dex_file.GetStringData(disk_string_id));
+                                                   dex_file.GetStringData(disk_string_id),
+                                                   /*copy=*/ !IsLazy());
         CreateAndAddIndexedItem(header_->StringIds(),
                                 header_->StringIds().GetOffset() + i * StringId::ItemSize(),
                                 i,
                                 string_data);
     }
 
+    void BuilderMaps::CreateStringIds(const DexFile &dex_file, base::ThreadPool *thread_pool) {
+        const uint32_t num_string_ids = dex_file.NumStringIds();
+        std::vector<StringData *> string_datas(num_string_ids);
+        thread_pool->ParallelFor(num_string_ids, [&](size_t i) {
+            const dex::StringId &disk_string_id = dex_file.GetStringId(dex::StringIndex(i));
+            string_datas[i] = header_->StringDatas().NewItem(dex_file.GetStringData(disk_string_id),
+                                                             /*copy=*/ !IsLazy());
+        });
+        for (uint32_t i = 0; i < num_string_ids; ++i) {
+            const dex::StringId &disk_string_id = dex_file.GetStringId(dex::StringIndex(i));
+            StringData *string_data = string_datas_map_.AddItem(header_->StringDatas(),
+                                                                eagerly_assign_offsets_,
+                                                                disk_string_id.string_data_off_,
+                                                                string_datas[i]);
+            CreateAndAddIndexedItem(header_->StringIds(),
+                                    header_->StringIds().GetOffset() + i * StringId::ItemSize(),
+                                    i,
+                                    string_data);
+        }
+    }
+
     void BuilderMaps::CreateTypeId(const DexFile &dex_file, uint32_t i) {
         const dex::TypeId &disk_type_id = dex_file.GetTypeId(dex::TypeIndex(i));
         CreateAndAddIndexedItem(header_->TypeIds(),
@@ -150,7 +172,7 @@ namespace dex_ir {
         const uint8_t *static_data = dex_file.GetEncodedStaticFieldValuesArray(disk_class_def);
         EncodedArrayItem *static_values =
                 CreateEncodedArrayItem(dex_file, static_data, disk_class_def.static_values_off_);
-        ClassData *class_data = CreateClassData(dex_file, disk_class_def);
+        ClassData *class_data = IsLazy() ? nullptr : CreateClassData(dex_file, disk_class_def);
         auto class_def = CreateAndAddIndexedItem(header_->ClassDefs(),
                                                  header_->ClassDefs().GetOffset() + i * ClassDef::ItemSize(),
                                                  i,
@@ -165,6 +187,9 @@ namespace dex_ir {
         if (class_data != nullptr) {
             class_data->SetClassDef(class_def);
         }
+        if (IsLazy() && disk_class_def.class_data_off_ != 0u) {
+            class_def->SetClassDataLoader(class_data_loader_);
+        }
     }
 
     void BuilderMaps::CreateCallSiteId(const DexFile &dex_file, uint32_t i) {
@@ -461,25 +486,57 @@ namespace dex_ir {
             return existing->second;
         }
 
+        DebugInfoItem *debug_info = DedupeOrCreateDebugInfoItem(dex_file, debug_info_offset);
+        CodeItem *code_item = DecodeCodeItem(dex_file, disk_code_item, dex_method_index, debug_info);
+        AddCodeItem(code_item, offset, debug_info_offset);
+
+        // Add "fixup" references to types, strings, methods, and fields.
+        // This is temporary, as we will probably want more detailed parsing of the
+        // instructions here.
+        return code_item;
+    }
+
+    DebugInfoItem *BuilderMaps::DedupeOrCreateDebugInfoItem(const DexFile &dex_file, uint32_t debug_info_offset) {
         const uint8_t *debug_info_stream = dex_file.GetDebugInfoStream(debug_info_offset);
-        DebugInfoItem *debug_info = nullptr;
-        if (debug_info_stream != nullptr) {
-            debug_info = debug_info_items_map_.GetExistingObject(debug_info_offset);
-            if (debug_info == nullptr) {
-                uint32_t debug_info_size = GetDebugInfoStreamSize(debug_info_stream);
-                uint8_t *debug_info_buffer = new uint8_t[debug_info_size];
-                memcpy(debug_info_buffer, debug_info_stream, debug_info_size);
-                debug_info = debug_info_items_map_.CreateAndAddItem(header_->DebugInfoItems(),
-                                                                    eagerly_assign_offsets_,
-                                                                    debug_info_offset,
-                                                                    debug_info_size,
-                                                                    debug_info_buffer);
-            }
+        if (debug_info_stream == nullptr) {
+            return nullptr;
+        }
+        DebugInfoItem *debug_info = debug_info_items_map_.GetExistingObject(debug_info_offset);
+        if (debug_info == nullptr) {
+            debug_info = debug_info_items_map_.AddItem(header_->DebugInfoItems(),
+                                                       eagerly_assign_offsets_,
+                                                       debug_info_offset,
+                                                       DecodeDebugInfoItem(debug_info_stream));
         }
+        return debug_info;
+    }
+
+    DebugInfoItem *BuilderMaps::DecodeDebugInfoItem(const uint8_t *debug_info_stream) {
+        uint32_t debug_info_size = GetDebugInfoStreamSize(debug_info_stream);
+        if (IsLazy()) {
+            return header_->DebugInfoItems().NewItem(debug_info_size,
+                                                     const_cast<uint8_t *>(debug_info_stream),
+                                                     /*owned=*/ false);
+        }
+        uint8_t *debug_info_buffer = new uint8_t[debug_info_size];
+        memcpy(debug_info_buffer, debug_info_stream, debug_info_size);
+        return header_->DebugInfoItems().NewItem(debug_info_size, debug_info_buffer);
+    }
 
+    CodeItem *BuilderMaps::DecodeCodeItem(const DexFile &dex_file,
+                                          const dex::CodeItem *disk_code_item,
+                                          uint32_t dex_method_index,
+                                          DebugInfoItem *debug_info) {
+        CodeItemDebugInfoAccessor accessor(dex_file, disk_code_item, dex_method_index);
         uint32_t insns_size = accessor.InsnsSizeInCodeUnits();
-        uint16_t *insns = new uint16_t[insns_size];
-        memcpy(insns, accessor.Insns(), insns_size * sizeof(uint16_t));
+        uint16_t *insns;
+        if (IsLazy()) {
+            // The mapping is private and writable, the kernel copies a page on its first write.
+            insns = const_cast<uint16_t *>(accessor.Insns());
+        } else {
+            insns = new uint16_t[insns_size];
+            memcpy(insns, accessor.Insns(), insns_size * sizeof(uint16_t));
+        }
 
         TryItemVector *tries = nullptr;
         CatchHandlerVector *handler_list = nullptr;
@@ -560,27 +617,29 @@ namespace dex_ir {
         }
 
         uint32_t size = dex_file.GetCodeItemSize(*disk_code_item);
-        CodeItem *code_item = header_->CodeItems().CreateAndAddItem(accessor.RegistersSize(),
-                                                                    accessor.InsSize(),
-                                                                    accessor.OutsSize(),
-                                                                    debug_info,
-                                                                    insns_size,
-                                                                    insns,
-                                                                    tries,
-                                                                    handler_list);
+        CodeItem *code_item = header_->CodeItems().NewItem(accessor.RegistersSize(),
+                                                           accessor.InsSize(),
+                                                           accessor.OutsSize(),
+                                                           debug_info,
+                                                           insns_size,
+                                                           insns,
+                                                           tries,
+                                                           handler_list,
+                                                           /*owned_insns=*/ !IsLazy());
         code_item->SetSize(size);
+        return code_item;
+    }
+
+    void BuilderMaps::AddCodeItem(CodeItem *code_item, uint32_t offset, uint32_t debug_info_offset) {
+        header_->CodeItems().AddItem(code_item);
         code_item->SetDebugInfoOffset(debug_info_offset);
+        code_item->SetSourceOffset(offset);
         // Add the code item to the map.
         DCHECK(!code_item->OffsetAssigned());
         if (eagerly_assign_offsets_) {
             code_item->SetOffset(offset);
         }
-        code_items_map_.emplace(offsets_pair, code_item);
-
-        // Add "fixup" references to types, strings, methods, and fields.
-        // This is temporary, as we will probably want more detailed parsing of the
-        // instructions here.
-        return code_item;
+        code_items_map_.emplace(std::make_pair(offset, debug_info_offset), code_item);
     }
 
     ClassData *BuilderMaps::CreateClassData(const DexFile &dex_file,
@@ -590,62 +649,173 @@ namespace dex_ir {
         const uint32_t offset = class_def.class_data_off_;
         ClassData *class_data = class_datas_map_.GetExistingObject(offset);
         if (class_data == nullptr && offset != 0u) {
-            ClassAccessor accessor(dex_file, class_def);
-            // Static fields.
-            FieldItemVector *static_fields = new FieldItemVector();
-            for (const ClassAccessor::Field &field: accessor.GetStaticFields()) {
-                FieldId *field_item = header_->FieldIds()[field.GetIndex()];
-                uint32_t access_flags = field.GetAccessFlags();
-                static_fields->emplace_back(access_flags, field_item);
-            }
-            FieldItemVector *instance_fields = new FieldItemVector();
-            for (const ClassAccessor::Field &field: accessor.GetInstanceFields()) {
-                FieldId *field_item = header_->FieldIds()[field.GetIndex()];
-                uint32_t access_flags = field.GetAccessFlags();
-                instance_fields->emplace_back(access_flags, field_item);
+            class_data = class_datas_map_.AddItem(header_->ClassDatas(),
+                                                  eagerly_assign_offsets_,
+                                                  offset,
+                                                  DecodeClassData(dex_file, class_def));
+            LinkMethodItems(class_data);
+        }
+        return class_data;
+    }
+
+    ClassData *BuilderMaps::DecodeClassData(const DexFile &dex_file, const dex::ClassDef &class_def) {
+        ClassAccessor accessor(dex_file, class_def);
+        // Static fields.
+        FieldItemVector *static_fields = new FieldItemVector();
+        for (const ClassAccessor::Field &field: accessor.GetStaticFields()) {
+            FieldId *field_item = header_->FieldIds()[field.GetIndex()];
+            uint32_t access_flags = field.GetAccessFlags();
+            static_fields->emplace_back(access_flags, field_item);
+        }
+        FieldItemVector *instance_fields = new FieldItemVector();
+        for (const ClassAccessor::Field &field: accessor.GetInstanceFields()) {
+            FieldId *field_item = header_->FieldIds()[field.GetIndex()];
+            uint32_t access_flags = field.GetAccessFlags();
+            instance_fields->emplace_back(access_flags, field_item);
+        }
+        // Direct methods.
+        MethodItemVector *direct_methods = new MethodItemVector();
+        auto direct_methods_it = accessor.GetDirectMethods();
+        for (auto it = direct_methods_it.begin(); it != direct_methods_it.end(); ++it) {
+            direct_methods->push_back(GenerateMethodItem(dex_file, *it));
+
+        }
+        // Virtual methods.
+        MethodItemVector *virtual_methods = new MethodItemVector();
+        auto virtual_methods_it = accessor.GetVirtualMethods();
+        const uint8_t *last_data_ptr;
+        for (auto it = virtual_methods_it.begin();; ++it) {
+            if (it == virtual_methods_it.end()) {
+                last_data_ptr = it->GetDataPointer();
+                break;
             }
-            // Direct methods.
-            MethodItemVector *direct_methods = new MethodItemVector();
-            auto direct_methods_it = accessor.GetDirectMethods();
-            for (auto it = direct_methods_it.begin(); it != direct_methods_it.end(); ++it) {
-                direct_methods->push_back(GenerateMethodItem(dex_file, *it));
+            virtual_methods->push_back(GenerateMethodItem(dex_file, *it));
+        }
+        ClassData *class_data = header_->ClassDatas().NewItem(static_fields,
+                                                              instance_fields,
+                                                              direct_methods,
+                                                              virtual_methods);
+        class_data->SetSize(last_data_ptr - dex_file.GetClassData(class_def));
+        for (int i = 0; i < static_fields->size(); ++i) {
+            static_fields->at(i).SetClassData(class_data);
+        }
+        for (int i = 0; i < instance_fields->size(); ++i) {
+            instance_fields->at(i).SetClassData(class_data);
+        }
+
+        for (int i = 0; i < direct_methods->size(); ++i) {
+            direct_methods->at(i)->SetClassData(class_data);
+        }
+        for (int i = 0; i < virtual_methods->size(); ++i) {
+            virtual_methods->at(i)->SetClassData(class_data);
+        }
+        return class_data;
+    }
 
+    void BuilderMaps::CreateClassDatas(const DexFile &dex_file, base::ThreadPool *thread_pool) {
+        struct CodeItemRef {
+            const dex::CodeItem *disk_code_item;
+            uint32_t offset;
+            uint32_t debug_info_offset;
+            uint32_t dex_method_index;
+        };
+        // Class defs that own a class data, in the order the serial walk first reaches the offset.
+        std::vector<const dex::ClassDef *> class_defs;
+        std::set<uint32_t> class_data_offsets;
+        for (uint32_t i = 0; i < dex_file.NumClassDefs(); ++i) {
+            const dex::ClassDef &class_def = dex_file.GetClassDef(i);
+            const uint32_t offset = class_def.class_data_off_;
+            if (offset != 0u && class_datas_map_.GetExistingObject(offset) == nullptr &&
+                class_data_offsets.insert(offset).second) {
+                class_defs.push_back(&class_def);
             }
-            // Virtual methods.
-            MethodItemVector *virtual_methods = new MethodItemVector();
-            auto virtual_methods_it = accessor.GetVirtualMethods();
-            const uint8_t *last_data_ptr;
-            for (auto it = virtual_methods_it.begin();; ++it) {
-                if (it == virtual_methods_it.end()) {
-                    last_data_ptr = it->GetDataPointer();
-                    break;
+        }
+
+        // Collect the code items of every method.
+        std::vector<std::vector<CodeItemRef>> code_item_refs(class_defs.size());
+        thread_pool->ParallelFor(class_defs.size(), [&](size_t i) {
+            ClassAccessor accessor(dex_file, *class_defs[i]);
+            for (const ClassAccessor::Method &method : accessor.GetMethods()) {
+                const dex::CodeItem *disk_code_item = method.GetCodeItem();
+                if (disk_code_item == nullptr) {
+                    continue;
                 }
-                virtual_methods->push_back(GenerateMethodItem(dex_file, *it));
-            }
-            class_data = class_datas_map_.CreateAndAddItem(header_->ClassDatas(),
-                                                           eagerly_assign_offsets_,
-                                                           offset,
-                                                           static_fields,
-                                                           instance_fields,
-                                                           direct_methods,
-                                                           virtual_methods);
-            class_data->SetSize(last_data_ptr - dex_file.GetClassData(class_def));
-            for (int i = 0; i < static_fields->size(); ++i) {
-                static_fields->at(i).SetClassData(class_data);
-            }
-            for (int i = 0; i < instance_fields->size(); ++i) {
-                instance_fields->at(i).SetClassData(class_data);
+                CodeItemDebugInfoAccessor code_accessor(dex_file, disk_code_item, method.GetIndex());
+                code_item_refs[i].push_back({disk_code_item,
+                                             method.GetCodeItemOffset(),
+                                             code_accessor.DebugInfoOffset(),
+                                             method.GetIndex()});
             }
+        });
 
-            for (int i = 0; i < direct_methods->size(); ++i) {
-                direct_methods->at(i)->SetClassData(class_data);
-            }
-            for (int i = 0; i < virtual_methods->size(); ++i) {
-                virtual_methods->at(i)->SetClassData(class_data);
+        // Dedupe them the same way DedupeOrCreateCodeItem does.
+        std::vector<const CodeItemRef *> code_items;
+        std::vector<uint32_t> debug_info_offsets;
+        std::map<std::pair<uint32_t, uint32_t>, size_t> code_item_slots;
+        std::map<uint32_t, size_t> debug_info_slots;
+        for (const std::vector<CodeItemRef> &refs : code_item_refs) {
+            for (const CodeItemRef &ref : refs) {
+                std::pair<uint32_t, uint32_t> offsets_pair(ref.offset, ref.debug_info_offset);
+                if (code_items_map_.find(offsets_pair) != code_items_map_.end() ||
+                    !code_item_slots.emplace(offsets_pair, code_items.size()).second) {
+                    continue;
+                }
+                code_items.push_back(&ref);
+                if (dex_file.GetDebugInfoStream(ref.debug_info_offset) != nullptr &&
+                    debug_info_items_map_.GetExistingObject(ref.debug_info_offset) == nullptr &&
+                    debug_info_slots.emplace(ref.debug_info_offset, debug_info_offsets.size()).second) {
+                    debug_info_offsets.push_back(ref.debug_info_offset);
+                }
             }
+        }
 
+        std::vector<DebugInfoItem *> debug_infos(debug_info_offsets.size());
+        thread_pool->ParallelFor(debug_info_offsets.size(), [&](size_t i) {
+            debug_infos[i] = DecodeDebugInfoItem(dex_file.GetDebugInfoStream(debug_info_offsets[i]));
+        });
+        for (size_t i = 0; i < debug_infos.size(); ++i) {
+            debug_info_items_map_.AddItem(header_->DebugInfoItems(),
+                                          eagerly_assign_offsets_,
+                                          debug_info_offsets[i],
+                                          debug_infos[i]);
+        }
+
+        std::vector<CodeItem *> decoded_code_items(code_items.size());
+        thread_pool->ParallelFor(code_items.size(), [&](size_t i) {
+            const CodeItemRef &ref = *code_items[i];
+            decoded_code_items[i] = DecodeCodeItem(dex_file,
+                                                   ref.disk_code_item,
+                                                   ref.dex_method_index,
+                                                   debug_info_items_map_.GetExistingObject(ref.debug_info_offset));
+        });
+        for (size_t i = 0; i < decoded_code_items.size(); ++i) {
+            AddCodeItem(decoded_code_items[i], code_items[i]->offset, code_items[i]->debug_info_offset);
+        }
+
+        // Every code item is known now, so decoding a class data only reads the maps.
+        std::vector<ClassData *> class_datas(class_defs.size());
+        thread_pool->ParallelFor(class_defs.size(), [&](size_t i) {
+            class_datas[i] = DecodeClassData(dex_file, *class_defs[i]);
+        });
+        for (size_t i = 0; i < class_datas.size(); ++i) {
+            class_datas_map_.AddItem(header_->ClassDatas(),
+                                     eagerly_assign_offsets_,
+                                     class_defs[i]->class_data_off_,
+                                     class_datas[i]);
+            LinkMethodItems(class_datas[i]);
+        }
+    }
+
+    void BuilderMaps::LinkMethodItems(ClassData *class_data) {
+        for (MethodItemVector *methods : {class_data->DirectMethods(), class_data->VirtualMethods()}) {
+            for (std::unique_ptr<MethodItem> &method : *methods) {
+                MethodItem *method_item = method.get();
+                if (method_item->GetCodeItem() != nullptr) {
+                    method_item->GetCodeItem()->SetMethodItem(method_item);
+                }
+                header_->MethodItems().insert(std::make_pair(method_item->GetRawId(), method_item));
+            }
         }
-        return class_data;
     }
 
     void BuilderMaps::SortVectorsByMapOrder() {
@@ -892,12 +1062,6 @@ namespace dex_ir {
                                                      method.GetCodeItemOffset(),
                                                      method.GetIndex());
         auto method_item = new MethodItem(access_flags, method_id, code_item, raw_method_id);
-        if (code_item != nullptr) {
-            code_item->SetMethodItem(method_item);
-        }
-        if (method_item != nullptr) {
-            header_->MethodItems().insert(std::make_pair(raw_method_id, method_item));
-        }
         return std::unique_ptr<MethodItem>(method_item);
     }
 
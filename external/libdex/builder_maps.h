@@ -9,6 +9,8 @@
 #include "indexed_collection_vector.h"
 #include "dex/class_accessor.h"
 #include "collection_map.h"
+#include "class_def.h"
+#include <libbase/thread_pool.h>
 
 
 namespace dex_ir {
@@ -16,11 +18,18 @@ namespace dex_ir {
 
     class BuilderMaps {
     public:
-        BuilderMaps(Header *header, bool eagerly_assign_offsets)
-                : header_(header), eagerly_assign_offsets_(eagerly_assign_offsets) {}
+        // With a class_data_loader the maps build a lazy Header: string data, code and debug info point
+        // into the dex file instead of being copied, and class data is left to the loader.
+        BuilderMaps(Header *header, bool eagerly_assign_offsets, ClassDataLoader *class_data_loader = nullptr)
+                : header_(header),
+                  eagerly_assign_offsets_(eagerly_assign_offsets),
+                  class_data_loader_(class_data_loader) {}
 
         void CreateStringId(const libdex::DexFile &dex_file, uint32_t i);
 
+        // Creates every StringId, decoding the string data on the thread pool.
+        void CreateStringIds(const libdex::DexFile &dex_file, base::ThreadPool *thread_pool);
+
         void CreateTypeId(const libdex::DexFile &dex_file, uint32_t i);
 
         void CreateProtoId(const libdex::DexFile &dex_file, uint32_t i);
@@ -63,6 +72,11 @@ namespace dex_ir {
 
         ClassData *CreateClassData(const libdex::DexFile &dex_file, const libdex::dex::ClassDef &class_def);
 
+        // Decodes the class data, code items and debug info of every class def on the thread pool.
+        // Items are registered in the order the serial walk creates them, so CreateClassDef only
+        // finds existing items afterwards and the resulting Header is the same as the serial one.
+        void CreateClassDatas(const libdex::DexFile &dex_file, base::ThreadPool *thread_pool);
+
         void AddAnnotationsFromMapListSection(const libdex::DexFile &dex_file,
                                               uint32_t start_offset,
                                               uint32_t count);
@@ -103,6 +117,24 @@ namespace dex_ir {
         std::unique_ptr<MethodItem>
         GenerateMethodItem(const libdex::DexFile &dex_file, const libdex::ClassAccessor::Method &method);
 
+        // The Decode* helpers only read the id tables and the builder maps, so they may run on worker
+        // threads. DecodeClassData may only do so once all its code items are in code_items_map_.
+        ClassData *DecodeClassData(const libdex::DexFile &dex_file, const libdex::dex::ClassDef &class_def);
+
+        CodeItem *DecodeCodeItem(const libdex::DexFile &dex_file,
+                                 const libdex::dex::CodeItem *disk_code_item,
+                                 uint32_t dex_method_index,
+                                 DebugInfoItem *debug_info);
+
+        DebugInfoItem *DecodeDebugInfoItem(const uint8_t *debug_info_stream);
+
+        DebugInfoItem *DedupeOrCreateDebugInfoItem(const libdex::DexFile &dex_file, uint32_t debug_info_offset);
+
+        void AddCodeItem(CodeItem *code_item, uint32_t offset, uint32_t debug_info_offset);
+
+        // Point the code items at their methods and register the methods in the Header.
+        void LinkMethodItems(ClassData *class_data);
+
         ParameterAnnotation *GenerateParameterAnnotation(
                 const libdex::DexFile &dex_file,
                 MethodId *method_id,
@@ -122,10 +154,13 @@ namespace dex_ir {
             return item;
         }
 
+        bool IsLazy() const { return class_data_loader_ != nullptr; }
+
         Header *header_;
         // If we eagerly assign offsets during IR building or later after layout. Must be false if
         // changing the layout is enabled.
         bool eagerly_assign_offsets_;
+        ClassDataLoader *class_data_loader_;
 
         // Note: maps do not have ownership.
         CollectionMap<StringData> string_datas_map_;
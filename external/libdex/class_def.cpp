@@ -62,9 +62,22 @@ namespace dex_ir {
     }
 
     ClassData *ClassDef::GetClassData() {
+        if (class_data_loader_ != nullptr) {
+            ClassDataLoader *class_data_loader = class_data_loader_;
+            class_data_loader_ = nullptr;
+            class_data_ = class_data_loader->LoadClassData(this);
+        }
         return class_data_;
     }
 
+    void ClassDef::SetClassDataLoader(ClassDataLoader *class_data_loader) {
+        class_data_loader_ = class_data_loader;
+    }
+
+    bool ClassDef::ClassDataLoaded() const {
+        return class_data_loader_ == nullptr;
+    }
+
     EncodedArrayItem *ClassDef::StaticValues() {
         return static_values_;
     }
@@ -13,6 +13,16 @@
 #include "annotation.h"
 
 namespace dex_ir {
+    class ClassDef;
+
+    // Decodes the class data of a ClassDef on first access, see DexIrLazyBuilder.
+    class ClassDataLoader {
+    public:
+        virtual ~ClassDataLoader() {}
+
+        virtual ClassData *LoadClassData(ClassDef *class_def) = 0;
+    };
+
     class ClassDef : public IndexedItem {
     public:
         ClassDef(const TypeId *class_type,
@@ -42,8 +52,13 @@ namespace dex_ir {
 
         AnnotationsDirectoryItem *Annotations() const;
 
+        // Decodes the class data first if it was deferred. Not thread safe.
         ClassData *GetClassData();
 
+        void SetClassDataLoader(ClassDataLoader *class_data_loader);
+
+        bool ClassDataLoaded() const;
+
         EncodedArrayItem *StaticValues();
 
         std::string getClassName() const;
@@ -61,6 +76,7 @@ namespace dex_ir {
         AnnotationsDirectoryItem *annotations_;  // This can be nullptr.
         ClassData *class_data_;  // This can be nullptr.
         EncodedArrayItem *static_values_;  // This can be nullptr.
+        ClassDataLoader *class_data_loader_ = nullptr;  // Set until the deferred class data is decoded.
         DISALLOW_COPY_AND_ASSIGN(ClassDef);
     };
 
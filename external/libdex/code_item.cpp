@@ -8,12 +8,18 @@ namespace dex_ir {
 
     CodeItem::CodeItem(uint16_t registers_size, uint16_t ins_size, uint16_t outs_size, DebugInfoItem *debug_info,
                        uint32_t insns_size, uint16_t *insns, TryItemVector *tries, CatchHandlerVector *handlers)
+            : CodeItem(registers_size, ins_size, outs_size, debug_info, insns_size, insns, tries, handlers, true) {}
+
+    CodeItem::CodeItem(uint16_t registers_size, uint16_t ins_size, uint16_t outs_size, DebugInfoItem *debug_info,
+                       uint32_t insns_size, uint16_t *insns, TryItemVector *tries, CatchHandlerVector *handlers,
+                       bool owned_insns)
             : registers_size_(registers_size),
               ins_size_(ins_size),
               outs_size_(outs_size),
               debug_info_(debug_info),
               insns_size_(insns_size),
               insns_(insns),
+              owned_insns_(owned_insns ? insns : nullptr),
               tries_(tries),
               handlers_(handlers) {}
 
@@ -41,7 +47,7 @@ namespace dex_ir {
 
     uint32_t CodeItem::InsnsSize() const { return insns_size_; }
 
-    uint16_t *CodeItem::Insns() const { return insns_.get(); }
+    uint16_t *CodeItem::Insns() const { return insns_; }
 
     TryItemVector *CodeItem::Tries() const { return tries_.get(); }
 
@@ -77,7 +83,8 @@ namespace dex_ir {
     }
 
     void CodeItem::RestInsns(uint16_t *data) {
-        insns_ = std::unique_ptr<uint16_t[]>(data);
+        owned_insns_ = std::unique_ptr<uint16_t[]>(data);
+        insns_ = data;
 
     }
 
@@ -89,6 +96,14 @@ namespace dex_ir {
         return debuf_info_off_;
     }
 
+    void CodeItem::SetSourceOffset(uint32_t off) {
+        this->source_offset_ = off;
+    }
+
+    uint32_t CodeItem::GetSourceOffset() const {
+        return source_offset_;
+    }
+
 
 
 
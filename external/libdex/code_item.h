@@ -26,6 +26,17 @@ namespace dex_ir {
                  TryItemVector *tries,
                  CatchHandlerVector *handlers);
 
+        // With owned_insns == false |insns| lives in the dex file mapping, see DexIrLazyBuilder.
+        CodeItem(uint16_t registers_size,
+                 uint16_t ins_size,
+                 uint16_t outs_size,
+                 DebugInfoItem *debug_info,
+                 uint32_t insns_size,
+                 uint16_t *insns,
+                 TryItemVector *tries,
+                 CatchHandlerVector *handlers,
+                 bool owned_insns);
+
         ~CodeItem() override;
 
         uint16_t RegistersSize() const;
@@ -68,19 +79,27 @@ namespace dex_ir {
 
         uint32_t GetDebugInfoOffset() const;
 
+        // Offset of the item in the dex file the IR was built from or last written to in full.
+        // DexWriter::Patch writes dirty items back there.
+        void SetSourceOffset(uint32_t off);
+
+        uint32_t GetSourceOffset() const;
+
     private:
         uint16_t registers_size_;
         uint16_t ins_size_;
         uint16_t outs_size_;
         DebugInfoItem *debug_info_;  // This can be nullptr.
         uint32_t insns_size_;
-        std::unique_ptr<uint16_t[]> insns_;
+        uint16_t *insns_;
+        std::unique_ptr<uint16_t[]> owned_insns_;
         std::unique_ptr<TryItemVector> tries_;  // This can be nullptr.
         std::unique_ptr<CatchHandlerVector> handlers_;  // This can be nullptr.
 
         MethodItem *methodItem_ = nullptr;
         //add start
         uint32_t debuf_info_off_ = 0;
+        uint32_t source_offset_ = 0;
         DISALLOW_COPY_AND_ASSIGN(CodeItem);
     };
 }
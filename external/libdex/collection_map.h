@@ -19,7 +19,15 @@ namespace dex_ir{
                             bool eagerly_assign_offsets,
                             uint32_t offset,
                             Args&&... args) {
-            T* item = vector.CreateAndAddItem(std::forward<Args>(args)...);
+            return AddItem(vector, eagerly_assign_offsets, offset, vector.NewItem(std::forward<Args>(args)...));
+        }
+
+        // Same as CreateAndAddItem for an item already created with vector.NewItem, e.g. on a worker thread.
+        T* AddItem(CollectionVector<T>& vector,
+                   bool eagerly_assign_offsets,
+                   uint32_t offset,
+                   T* object) {
+            T* item = vector.AddItem(object);
             DCHECK(!GetExistingObject(offset));
             DCHECK(!item->OffsetAssigned());
             if (eagerly_assign_offsets) {
@@ -9,6 +9,8 @@
 #include <memory>
 #include <vector>
 #include "dexir_util.h"
+#include "libbase/arena_allocator.h"
+#include "libbase/logging.h"
 #include <algorithm>
 #include <iostream>
 
@@ -17,7 +19,8 @@ namespace dex_ir {
     template<class T>
     class CollectionVector : public CollectionBase {
     public:
-        using ElementType = std::unique_ptr<T>;
+        // Items live in the arena of the owning Header, the vector only runs their destructors.
+        using ElementType = std::unique_ptr<T, base::ArenaDelete<T>>;
 
         CollectionVector() {}
 
@@ -28,10 +31,25 @@ namespace dex_ir {
 
         ~CollectionVector() override {}
 
+        void SetAllocator(base::ArenaAllocator *allocator) { allocator_ = allocator; }
+
+        base::ArenaAllocator *GetAllocator() const { return allocator_; }
+
         template<class... Args>
         T *CreateAndAddItem(Args &&... args) {
-            T *object = new T(std::forward<Args>(args)...);
-            collection_.push_back(std::unique_ptr<T>(object));
+            return AddItem(NewItem(std::forward<Args>(args)...));
+        }
+
+        // Creates an item in the arena without adding it, e.g. on a worker thread.
+        template<class... Args>
+        T *NewItem(Args &&... args) const {
+            DCHECK(allocator_ != nullptr);
+            return allocator_->template New<T>(std::forward<Args>(args)...);
+        }
+
+        // Take ownership of an item created by NewItem.
+        T *AddItem(T *object) {
+            collection_.push_back(ElementType(object));
             return object;
         }
 
@@ -68,6 +86,7 @@ namespace dex_ir {
 
     protected:
         std::vector<ElementType> collection_;
+        base::ArenaAllocator *allocator_ = nullptr;
 
     private:
         DISALLOW_COPY_AND_ASSIGN(CollectionVector);
@@ -11,15 +11,22 @@ namespace dex_ir {
     class DebugInfoItem : public Item {
     public:
         DebugInfoItem(uint32_t debug_info_size, uint8_t *debug_info)
-                : debug_info_size_(debug_info_size), debug_info_(debug_info) {}
+                : DebugInfoItem(debug_info_size, debug_info, true) {}
+
+        // With owned == false the stream lives in the dex file mapping, see DexIrLazyBuilder.
+        DebugInfoItem(uint32_t debug_info_size, uint8_t *debug_info, bool owned)
+                : debug_info_size_(debug_info_size),
+                  debug_info_(debug_info),
+                  owned_debug_info_(owned ? debug_info : nullptr) {}
 
         uint32_t GetDebugInfoSize() const { return debug_info_size_; }
 
-        uint8_t *GetDebugInfo() const { return debug_info_.get(); }
+        uint8_t *GetDebugInfo() const { return debug_info_; }
 
     private:
         uint32_t debug_info_size_;
-        std::unique_ptr<uint8_t[]> debug_info_;
+        uint8_t *debug_info_;
+        std::unique_ptr<uint8_t[]> owned_debug_info_;
 
         DISALLOW_COPY_AND_ASSIGN(DebugInfoItem);
     };
@@ -3,182 +3,84 @@
 //
 
 #include "decompilation.h"
-#include "libdex/dex/dex_instruction-inl.h"
+#include <libbase/thread_pool.h>
 #include <regex>
 
 namespace dex_ir {
 
+    namespace {
+        template<class T>
+        std::set<T *> ToIdSet(const IndexedCollectionVector<T> &ids, const std::vector<uint32_t> &indices) {
+            std::set<T *> result;
+            for (uint32_t idx : indices) {
+                result.insert(ids[idx]);
+            }
+            return result;
+        }
+    }
+
     Decompilation::Decompilation(Header *header) {
         this->header_ = header;
     }
 
-    bool Decompilation::loadReferences() {
-        if (indexed) {
+    bool Decompilation::loadReferences(size_t thread_count, const std::string &index_cache_path) {
+        // The index lives in the Header, another Decompilation may have loaded it already.
+        if (indexed || header_->GetXrefIndex() != nullptr) {
+            indexed = true;
             return correct;
         }
-        // Iterate over all classes.
-        const uint32_t class_defs_size = header_->ClassDefs().Size();
-        for (uint32_t i = 0; i < class_defs_size; i++) {
-            loadClass(i);
-        }  // for
-        indexed = true;
-        return correct;
-    }
-
-    void Decompilation::loadClass(int idx) {
-        dex_ir::ClassDef *class_def = header_->ClassDefs()[idx];
-        dex_ir::ClassData *class_data = class_def->GetClassData();
-        // Direct methods.
-        if (class_data != nullptr) {
-            dex_ir::MethodItemVector *direct_methods = class_data->DirectMethods();
-            if (direct_methods != nullptr) {
-                for (uint32_t i = 0; i < direct_methods->size(); i++) {
-                    loadMethod((*direct_methods)[i]->GetMethodId()->GetIndex(),
-                               (*direct_methods)[i]->GetAccessFlags(),
-                               (*direct_methods)[i]->GetCodeItem(),
-                               i);
-                }  // for
+        std::string error_msg;
+        std::unique_ptr<XrefIndex> xref_index;
+        // The cache describes the parsed file, not code edited in memory since.
+        bool use_cache = !index_cache_path.empty() && header_->DirtyCodeItems().empty();
+        if (use_cache) {
+            xref_index.reset(XrefIndex::Load(index_cache_path, header_, &error_msg));
+            if (xref_index == nullptr) {
+                LOG(DEBUG) << "xref index not loaded: " << error_msg;
             }
-        }// Virtual methods.
-        if (class_data != nullptr) {
-            dex_ir::MethodItemVector *virtual_methods = class_data->VirtualMethods();
-            if (virtual_methods != nullptr) {
-                for (uint32_t i = 0; i < virtual_methods->size(); i++) {
-                    loadMethod((*virtual_methods)[i]->GetMethodId()->GetIndex(),
-                               (*virtual_methods)[i]->GetAccessFlags(),
-                               (*virtual_methods)[i]->GetCodeItem(),
-                               i);
-                }  // for
+        }
+        if (xref_index == nullptr) {
+            // The index needs every code item, a lazy header is only materialized on a cache miss.
+            header_->MaterializeAll();
+            base::ThreadPool thread_pool(thread_count);
+            xref_index.reset(XrefIndex::Build(header_, &thread_pool));
+            if (use_cache && !xref_index->Save(index_cache_path, &error_msg)) {
+                LOG(WARNING) << "save xref index fail: " << error_msg;
             }
         }
-
+        xref_index->FillRefs(header_);
+        header_->SetXrefIndex(xref_index.release());
+        indexed = true;
+        return correct;
     }
 
-    void Decompilation::loadMethod(uint32_t idx, uint32_t flags, const dex_ir::CodeItem *code, int i) {
-        if (code == nullptr) {
-            return;
+    bool Decompilation::loadSymbolIndex() {
+        if (header_->GetSymbolIndex() == nullptr) {
+            // Every id lives in the header even when class data is loaded lazily.
+            header_->SetSymbolIndex(new SymbolIndex(header_));
         }
-        loadCode(idx, code);
+        return true;
     }
 
-    void Decompilation::loadCode(uint32_t idx, const dex_ir::CodeItem *code) {
-        loadBytecodes(idx, code);
-    }
-
-    void Decompilation::loadBytecodes(uint32_t idx, const dex_ir::CodeItem *code) {
-        for (const libdex::DexInstructionPcPair &inst: code->Instructions()) {
-            const uint32_t insn_width = inst->SizeInCodeUnits();
-            if (insn_width == 0) {
-                LOG(WARNING) << "GLITCH: zero-width instruction at idx=0x" << std::hex << inst.DexPc();
-                break;
-            }
-            loadInstruction(code, inst.DexPc(), insn_width, &inst.Inst());
-        }  // for
-    }
-
-    void Decompilation::loadInstruction(const dex_ir::CodeItem *code, uint32_t insn_idx,
-                                        uint32_t insn_width, const libdex::Instruction *dec_insn) {
-        const uint16_t *insns = code->Insns();
-        if (libdex::Instruction::IndexTypeOf(dec_insn->Opcode()) != libdex::Instruction::kIndexNone) {
-            loadIndex(code->GetMethodItem(), dec_insn);
+    bool Decompilation::decompileAll(size_t thread_count, bool with_dataflow) {
+        if (decompile_cache_ == nullptr) {
+            base::ThreadPool thread_pool(thread_count);
+            decompile_cache_.reset(DecompileCache::Build(header_, &thread_pool, with_dataflow));
         }
+        return true;
     }
 
-    void Decompilation::loadIndex(MethodItem *methodItem, const libdex::Instruction *dec_insn) {
-        uint32_t index = 0;
-        uint32_t secondary_index = libdex::dex::kDexNoIndex;
-        uint32_t width = 4;
-        switch (libdex::Instruction::FormatOf(dec_insn->Opcode())) {
-            // SOME NOT SUPPORTED:
-            // case Instruction::k20bc:
-            case libdex::Instruction::k21c:
-            case libdex::Instruction::k35c:
-                // case Instruction::k35ms:
-            case libdex::Instruction::k3rc:
-                // case Instruction::k3rms:
-                // case Instruction::k35mi:
-                // case Instruction::k3rmi:
-                index = dec_insn->VRegB();
-                width = 4;
-                break;
-            case libdex::Instruction::k31c:
-                index = dec_insn->VRegB();
-                width = 8;
-                break;
-            case libdex::Instruction::k22c:
-                // case Instruction::k22cs:
-                index = dec_insn->VRegC();
-                width = 4;
-                break;
-            case libdex::Instruction::k45cc:
-            case libdex::Instruction::k4rcc:
-                index = dec_insn->VRegB();
-                secondary_index = dec_insn->VRegH();
-                width = 4;
-                break;
-            default:
-                break;
-        }  // switch
-
-        switch (libdex::Instruction::IndexTypeOf(dec_insn->Opcode())) {
-            case libdex::Instruction::kIndexUnknown:
-            case libdex::Instruction::kIndexNone:
-                break;
-            case libdex::Instruction::kIndexTypeRef:
-                if (index < header_->TypeIds().Size()) {
-                    auto type_id = header_->TypeIds()[index];
-                    //const char *tp = ->GetStringId()->Data();
-                    type_id->AddMethodRef(methodItem->GetRawId());
-                    methodItem->AddTypeRef(index);
-                }
-                break;
-            case libdex::Instruction::kIndexStringRef:
-                if (index < header_->StringIds().Size()) {
-                    auto string_id = header_->StringIds()[index];
-                    //const char *st = header->GetCollections().GetStringId(index)->Data();
-                    string_id->AddMethodRefs(methodItem->GetRawId());
-                    methodItem->AddStringRef(index);
-                }
-                break;
-            case libdex::Instruction::kIndexMethodRef:
-                if (index < header_->MethodIds().Size()) {
-                    auto method_id = header_->MethodIds()[index];
-                    /* const char *name = method_id->Name()->Data();
-                   std::string type_descriptor = GetSignatureForProtoId(method_id->Proto());
-                   const char *back_descriptor = method_id->Class()->GetStringId()->Data();
-                   outSize = snprintf(buf.get(), buf_size, "%s.%s:%s // method@%0*x",
-                                      back_descriptor, name, type_descriptor.c_str(), width, index);*/
-                    method_id->AddMethodRefs(methodItem->GetRawId());
-                    methodItem->AddMethodRef(index);
-                }
-                break;
-            case libdex::Instruction::kIndexFieldRef:
-                if (index < header_->FieldIds().Size()) {
-                    dex_ir::FieldId *field_id = header_->FieldIds()[index];
-                    /* const char *name = field_id->Name()->Data();
-                     const char *type_descriptor = field_id->Type()->GetStringId()->Data();
-                     const char *back_descriptor = field_id->Class()->GetStringId()->Data();
-                     outSize = snprintf(buf.get(), buf_size, "%s.%s:%s // field@%0*x",
-                                        back_descriptor, name, type_descriptor, width, index);*/
-                    field_id->AddMethodRefs(methodItem->GetRawId());
-                    methodItem->AddFieldRef(index);
-                }
-                break;
-            case libdex::Instruction::kIndexVtableOffset:
-            case libdex::Instruction::kIndexFieldOffset:
-            case libdex::Instruction::kIndexMethodAndProtoRef:
-                break;
-                // SOME NOT SUPPORTED:
-                // case Instruction::kIndexVaries:
-                // case Instruction::kIndexInlineMethod:
-            default:
-                break;
-        }  // switch
-
+    DecompileMethod *Decompilation::getDecompileMethod(uint32_t method_idx) const {
+        return decompile_cache_ == nullptr ? nullptr : decompile_cache_->Get(method_idx);
     }
 
     StringId *Decompilation::getStringIdByValue(std::string value) const {
-        for (std::unique_ptr<StringId> &stringId: header_->StringIds()) {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            int64_t idx = symbol_index->FindString(value);
+            return idx < 0 ? nullptr : header_->StringIds()[idx];
+        }
+        for (auto &stringId: header_->StringIds()) {
             if (value.compare(stringId->Data()) == 0) {
                 return stringId.get();
             }
@@ -187,9 +89,13 @@ namespace dex_ir {
     }
 
     std::set<StringId *> Decompilation::getStringIdRegex(std::string value_regex) const {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            return ToIdSet(header_->StringIds(), symbol_index->MatchStrings(RegexFilter(value_regex)));
+        }
         std::regex regex(value_regex);
         std::set<StringId *> results;
-        for (std::unique_ptr<StringId> &stringId: header_->StringIds()) {
+        for (auto &stringId: header_->StringIds()) {
             std::string data = stringId->Data();
             if (data.empty())continue;
             if (std::regex_match(data, regex)) {
@@ -200,8 +106,12 @@ namespace dex_ir {
     }
 
     std::set<StringId *> Decompilation::getStringIdAllContains(std::string value) const {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            return ToIdSet(header_->StringIds(), symbol_index->FindStringsContaining(value, false));
+        }
         std::set<StringId *> string_ids;
-        for (std::unique_ptr<StringId> &stringId: header_->StringIds()) {
+        for (auto &stringId: header_->StringIds()) {
             if (stringId->Data() == nullptr)continue;
             std::string temp = stringId->Data();
             if (temp.find(value) != std::string::npos) {
@@ -212,7 +122,12 @@ namespace dex_ir {
     }
 
     StringId *Decompilation::getStringIdFirstContains(std::string value) const {
-        for (std::unique_ptr<StringId> &stringId: header_->StringIds()) {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            std::vector<uint32_t> indices = symbol_index->FindStringsContaining(value, true);
+            return indices.empty() ? nullptr : header_->StringIds()[indices[0]];
+        }
+        for (auto &stringId: header_->StringIds()) {
             if (stringId->Data() == nullptr)continue;
             std::string temp = stringId->Data();
             if (temp.find(value) != std::string::npos) {
@@ -222,6 +137,44 @@ namespace dex_ir {
         return nullptr;
     }
 
+    std::vector<std::set<StringId *>>
+    Decompilation::getStringIdAllContains(const std::vector<std::string> &values) const {
+        std::vector<std::set<StringId *>> results;
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index == nullptr) {
+            for (const std::string &value : values) {
+                results.push_back(getStringIdAllContains(value));
+            }
+            return results;
+        }
+        for (const auto &indices : symbol_index->FindStringsContaining(values)) {
+            results.push_back(ToIdSet(header_->StringIds(), indices));
+        }
+        return results;
+    }
+
+    std::vector<std::set<StringId *>>
+    Decompilation::getStringIdRegex(const std::vector<std::string> &value_regexes) const {
+        std::vector<std::set<StringId *>> results;
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index == nullptr) {
+            for (const std::string &value_regex : value_regexes) {
+                results.push_back(getStringIdRegex(value_regex));
+            }
+            return results;
+        }
+        std::vector<std::unique_ptr<RegexFilter>> filters;
+        std::vector<const RegexFilter *> filter_ptrs;
+        for (const std::string &value_regex : value_regexes) {
+            filters.emplace_back(new RegexFilter(value_regex));
+            filter_ptrs.push_back(filters.back().get());
+        }
+        for (const auto &indices : symbol_index->MatchStrings(filter_ptrs)) {
+            results.push_back(ToIdSet(header_->StringIds(), indices));
+        }
+        return results;
+    }
+
     /**
      * find method_id by signature
      * @param class_name The class to which the function belongs eg:Ljava/lang/System;
@@ -231,6 +184,11 @@ namespace dex_ir {
      */
     MethodId *
     Decompilation::getMethodIdBySignatrue(std::string class_name, std::string method_name, std::string signature) {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            int64_t idx = symbol_index->FindMethod({class_name, method_name, signature});
+            return idx < 0 ? nullptr : header_->MethodIds()[idx];
+        }
         for (const auto &method_id: header_->MethodIds()) {
             if (class_name.compare(method_id->Class()->GetStringId()->Data()) != 0) {
                 continue;
@@ -246,8 +204,21 @@ namespace dex_ir {
         return nullptr;
     }
 
+    std::vector<MethodId *> Decompilation::getMethodIdBySignatrue(const std::vector<MemberSignature> &signatures) {
+        std::vector<MethodId *> method_ids;
+        for (const MemberSignature &signature : signatures) {
+            method_ids.push_back(getMethodIdBySignatrue(signature.class_name, signature.name, signature.signature));
+        }
+        return method_ids;
+    }
+
     FieldId *
     Decompilation::getFieldIdBySignatrue(std::string class_name, std::string field_name, std::string signature) {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            int64_t idx = symbol_index->FindField({class_name, field_name, signature});
+            return idx < 0 ? nullptr : header_->FieldIds()[idx];
+        }
         for (const auto &field_id: header_->FieldIds()) {
             if (class_name.compare(field_id->Class()->GetStringId()->Data()) != 0) {
                 continue;
@@ -264,6 +235,11 @@ namespace dex_ir {
     }
 
     TypeId *Decompilation::getTypeIdIdBySignatrue(std::string value) const {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            int64_t idx = symbol_index->FindType(value);
+            return idx < 0 ? nullptr : header_->TypeIds()[idx];
+        }
         for (const auto &type_id: header_->TypeIds()) {
             if (value == type_id->GetStringId()->Data()) {
                 return type_id.get();
@@ -274,6 +250,12 @@ namespace dex_ir {
 
     std::set<MethodId *> Decompilation::getMethodIdByRegex(std::string class_name_regex, std::string method_name_regex,
                                                            std::string signature_regex_) {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            return ToIdSet(header_->MethodIds(),
+                           symbol_index->MatchMethods(RegexFilter(class_name_regex), RegexFilter(method_name_regex),
+                                                      RegexFilter(signature_regex_)));
+        }
         std::set<MethodId *> method_ids;
         std::regex classe_regex(class_name_regex);
         std::regex method_regex(method_name_regex);
@@ -298,6 +280,10 @@ namespace dex_ir {
     }
 
     std::set<TypeId *> Decompilation::getTypeIdIdByRegex(std::string value_regex) const {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            return ToIdSet(header_->TypeIds(), symbol_index->MatchTypes(RegexFilter(value_regex)));
+        }
         std::regex regex(value_regex);
         std::set<TypeId *> results;
         for (const auto &type_id: header_->TypeIds()) {
@@ -312,6 +298,12 @@ namespace dex_ir {
 
     std::set<FieldId *> Decompilation::getFieldIdByRegex(std::string class_name_regex, std::string field_name_regex,
                                                          std::string signature_regex_) const {
+        const SymbolIndex *symbol_index = header_->GetSymbolIndex();
+        if (symbol_index != nullptr) {
+            return ToIdSet(header_->FieldIds(),
+                           symbol_index->MatchFields(RegexFilter(class_name_regex), RegexFilter(field_name_regex),
+                                                     RegexFilter(signature_regex_)));
+        }
         std::set<FieldId *> field_ids;
         std::regex classe_regex(class_name_regex);
         std::regex method_regex(field_name_regex);
@@ -7,6 +7,7 @@
 
 
 #include "header.h"
+#include "decompile_method.h"
 
 namespace dex_ir {
     class Decompilation {
@@ -16,7 +17,30 @@ namespace dex_ir {
         ~Decompilation() {
         };
 
-        bool loadReferences();
+        // Indexes the string, type, field and method references of every method's code and fills
+        // the Get*Refs() sets of the ids and method items. With |thread_count| above one the code is
+        // decoded on a thread pool. When |index_cache_path| is set the index is read from that file
+        // if it was saved for this dex, and written there otherwise. The cache is neither read nor
+        // written while the header has dirty code items, the index is then built from the edited code.
+        bool loadReferences(size_t thread_count = 1, const std::string &index_cache_path = "");
+
+        // The index behind loadReferences, owned by the Header. nullptr before it ran.
+        const XrefIndex *getXrefIndex() const { return header_->GetXrefIndex(); }
+
+        // Builds the hash, prefix and trigram lookup index of the ids, owned by the Header. The
+        // queries below use it once built and scan the ids otherwise, with the same results.
+        bool loadSymbolIndex();
+
+        const SymbolIndex *getSymbolIndex() const { return header_->GetSymbolIndex(); }
+
+        // Decompiles every method with code on |thread_count| threads and keeps the results, see
+        // DecompileCache. Later calls reuse the cache.
+        bool decompileAll(size_t thread_count = 1, bool with_dataflow = true);
+
+        const DecompileCache *getDecompileCache() const { return decompile_cache_.get(); }
+
+        // The cached DecompileMethod of method |method_idx|, nullptr before decompileAll or without code.
+        DecompileMethod *getDecompileMethod(uint32_t method_idx) const;
 
         StringId *getStringIdByValue(std::string value) const;
 
@@ -26,6 +50,13 @@ namespace dex_ir {
 
         std::set<StringId *> getStringIdRegex(std::string value_regex) const;
 
+        // Batch forms, one result per query in the order of the queries.
+        std::vector<std::set<StringId *>> getStringIdAllContains(const std::vector<std::string> &values) const;
+
+        std::vector<std::set<StringId *>> getStringIdRegex(const std::vector<std::string> &value_regexes) const;
+
+        std::vector<MethodId *> getMethodIdBySignatrue(const std::vector<MemberSignature> &signatures);
+
 
         std::set<MethodId *>
         getMethodIdByRegex(std::string class_name_regex, std::string method_name_regex,
@@ -43,26 +74,9 @@ namespace dex_ir {
         std::set<FieldId *> getFieldIdByRegex(std::string class_name_regex, std::string field_name_regex,
                                               std::string signature_regex_) const ;
 
-    private:
-        void loadClass(int idx);
-
-        void loadMethod(uint32_t idx, uint32_t flags, const dex_ir::CodeItem *code, int i);
-
-        void loadCode(uint32_t idx, const dex_ir::CodeItem *code);
-
-        void loadBytecodes(uint32_t idx, const dex_ir::CodeItem *code);
-
-        void loadInstruction(const dex_ir::CodeItem *code, uint32_t insn_idx, uint32_t insn_width,
-                             const libdex::Instruction *dec_insn);
-
-        void loadIndex(MethodItem *methodItem, const libdex::Instruction *dec_insn);
-
-
-    private:
-
-
     private:
         Header *header_;
+        std::unique_ptr<DecompileCache> decompile_cache_;
         bool indexed = false;
         bool correct = true;
         bool debug_info;
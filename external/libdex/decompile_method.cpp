@@ -206,13 +206,13 @@ dex_ir::DecompileMethod::DecompileMethod(dex_ir::Header *header, uint32_t raw_id
         LOG(ERROR) << "check your dex_ir::Header==nullptr ?";
         return;
     }
-    auto find = header->MethodItems().find(raw_id);
-    if (find == header->MethodItems().end()) {
+    // Loads the defining class on a lazy header.
+    this->methodItem_ = header->GetMethodItem(raw_id);
+    if (this->methodItem_ == nullptr) {
         init_error = true;
         LOG(ERROR) << "can't find method_item with raw_id:" << raw_id;
         return;
     }
-    this->methodItem_ = find->second;
     process();
 }
 
@@ -399,7 +399,8 @@ dex_ir::DecompileMethod::processInstruction(const dex_ir::CodeItem *code, uint32
         case libdex::Instruction::k31c: {        // op vAA, thing@BBBBBBBB
             if (dec_insn->Opcode() == libdex::Instruction::CONST_STRING_JUMBO) {
                 uint32_t string_idx = dec_insn->VRegB_31c();
-                decompileCode.op_string_idx = dec_insn->VRegA_31c();
+                decompileCode.dest_register = dec_insn->VRegA_31c();
+                decompileCode.op_string_idx = string_idx;
 
             } else {
                 decompileCode.dest_register = dec_insn->VRegA();
@@ -772,40 +773,64 @@ uint32_t dex_ir::DecompileMethod::GetIndexId(const libdex::Instruction *dec_insn
 }
 
 int64_t dex_ir::DecompileMethod::GetRegisterOpValue(uint32_t register_name, uint32_t limit_pc) {
-    if (register_name == -1) {
+    const RegisterDataflow *dataflow = GetDataflow();
+    if (register_name == -1 || dataflow == nullptr) {
         return -1;
     }
-    int64_t result = -1;
-    for (const auto &methodbodyline: methodbodylines) {
-        if (limit_pc != 0 && methodbodyline.pc_ >= limit_pc) {
-            return result;
-        }
-        if (methodbodyline.dest_register == register_name) {
-            result = methodbodyline.op_value;
-        }
-    }
-    return result;
+    RegisterDataflow::Value value = limit_pc == 0 ? dataflow->GetLastValue(register_name)
+                                                  : dataflow->GetValue(register_name, limit_pc);
+    return value.kind == RegisterDataflow::kConstant ? value.value : -1;
 }
 
 std::string dex_ir::DecompileMethod::GetRegisterOpString(uint32_t register_name, uint32_t limit_pc) {
-    if (register_name == -1) {
+    const RegisterDataflow *dataflow = GetDataflow();
+    if (register_name == -1 || dataflow == nullptr) {
         return std::string();
     }
-    uint32_t result_index_id = -1;
-    for (const auto &methodbodyline: methodbodylines) {
-        if (limit_pc != 0 && methodbodyline.pc_ >= limit_pc) {
-            return std::string();
-        }
-        if (methodbodyline.dest_register == register_name) {
-            result_index_id = methodbodyline.op_string_idx;
-        }
-    }
-    if (result_index_id <= this->header_->StringIds().Size()) {
-        return this->header_->StringIds()[(result_index_id)]->Data();
+    RegisterDataflow::Value value = limit_pc == 0 ? dataflow->GetLastValue(register_name)
+                                                  : dataflow->GetValue(register_name, limit_pc);
+    if (value.kind == RegisterDataflow::kString && value.value < this->header_->StringIds().Size()) {
+        return this->header_->StringIds()[value.value]->Data();
     }
     return std::string();
 }
 
+const dex_ir::RegisterDataflow *dex_ir::DecompileMethod::GetDataflow() {
+    if (init_error || methodItem_->GetCodeItem() == nullptr) {
+        return nullptr;
+    }
+    if (dataflow_ == nullptr) {
+        dataflow_.reset(new RegisterDataflow(methodItem_->GetCodeItem()));
+    }
+    return dataflow_.get();
+}
+
 const std::vector<std::string> &dex_ir::DecompileMethod::getMethodbodytext() const {
     return methodbodytext;
 }
+
+dex_ir::DecompileCache *
+dex_ir::DecompileCache::Build(dex_ir::Header *header, base::ThreadPool *thread_pool, bool with_dataflow) {
+    header->MaterializeAll();
+    std::vector<MethodItem *> method_items;
+    for (auto &entry : header->MethodItems()) {
+        // Abstract and native methods have nothing to decompile.
+        if (entry.second->GetCodeItem() != nullptr) {
+            method_items.push_back(entry.second);
+        }
+    }
+    DecompileCache *cache = new DecompileCache();
+    cache->methods_.resize(header->MethodIds().Size());
+    cache->size_ = method_items.size();
+    // Every method item fills its own slot, so the chunks need no locking.
+    thread_pool->ParallelForRange(method_items.size(), 16u, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            DecompileMethod *method = new DecompileMethod(header, method_items[i]);
+            if (with_dataflow) {
+                method->GetDataflow();
+            }
+            cache->methods_[method_items[i]->GetRawId()].reset(method);
+        }
+    });
+    return cache;
+}
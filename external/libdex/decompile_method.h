@@ -5,9 +5,12 @@
 #ifndef BASE_DECOMPILE_METHOD_H
 #define BASE_DECOMPILE_METHOD_H
 
+#include <memory>
 #include <vector>
 #include <string>
+#include <libbase/thread_pool.h>
 #include "header.h"
+#include "register_dataflow.h"
 
 namespace dex_ir {
 
@@ -55,19 +58,22 @@ namespace dex_ir {
         /**
          * 获取寄存器opvauel值
          * @param register_name
-         * @param limit_pc
-         * @return
+         * @param limit_pc 读取寄存器的指令偏移, 0 表示取方法中最后一次写入的值
+         * @return 到达 limit_pc 的所有定义都是同一个常量时返回该常量, 否则返回 -1
          */
         int64_t GetRegisterOpValue(uint32_t register_name, uint32_t limit_pc = 0);
 
         /**
         * 获取寄存器string id值
         * @param register_name
-        * @param limit_pc
+        * @param limit_pc 同上
         * @return
         */
         std::string GetRegisterOpString(uint32_t register_name, uint32_t limit_pc = 0);
 
+        // Reaching definitions of the registers, built on first use. nullptr without code.
+        const RegisterDataflow *GetDataflow();
+
 
     public:
 
@@ -110,6 +116,31 @@ namespace dex_ir {
         MethodItem *methodItem_;
         std::vector<DecompileCode> methodbodylines;
         std::vector<std::string> methodbodytext;
+        std::unique_ptr<RegisterDataflow> dataflow_;
+    };
+
+    // The DecompileMethod of every method with code in a Header, kept for repeated queries.
+    class DecompileCache {
+    public:
+        // Decompiles the methods in chunks on |thread_pool|. With |with_dataflow| the register
+        // dataflow is built in the same pass, the cached methods are then only read by queries and
+        // may be shared between threads. A lazy header is materialized first.
+        static DecompileCache *Build(Header *header, base::ThreadPool *thread_pool, bool with_dataflow);
+
+        // nullptr for methods defined in another dex or without code.
+        DecompileMethod *Get(uint32_t method_idx) const {
+            return method_idx < methods_.size() ? methods_[method_idx].get() : nullptr;
+        }
+
+        size_t Size() const { return size_; }
+
+    private:
+        DecompileCache() {}
+
+        std::vector<std::unique_ptr<DecompileMethod>> methods_;
+        size_t size_ = 0;
+
+        DISALLOW_COPY_AND_ASSIGN(DecompileCache);
     };
 }
 
@@ -17,6 +17,7 @@
 #ifndef ART_LIBDEXFILE_DEX_COMPACT_OFFSET_TABLE_H_
 #define ART_LIBDEXFILE_DEX_COMPACT_OFFSET_TABLE_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -30,6 +30,7 @@
 #include "libbase/stringprintf.h"
 
 
+#include "libbase/checksum.h"
 #include "libbase/leb128.h"
 #include "libbase/stl_util.h"
 #include "class_accessor-inl.h"
@@ -69,51 +70,8 @@ namespace libdex {
         return ChecksumMemoryRange(begin + non_sum_bytes, size - non_sum_bytes);
     }
 
-#define ADLER32_BASE 65521
-/* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
-#define ADLER32_NMAX 5552
-
-    unsigned int adler32_(unsigned int adler, const void *buffer, int len) {
-        const unsigned char *buf;
-        unsigned int sum2, n;
-
-        if (!buffer || (len <= 0))
-            return 1;
-
-        buf = (const unsigned char *) buffer;
-
-        sum2 = (adler >> 16) & 0xffff;
-        adler &= 0xffff;
-
-        while (len >= ADLER32_NMAX) {
-            n = ADLER32_NMAX;
-
-            while (n--) {
-                adler += *buf++;
-                sum2 += adler;
-            }
-
-            adler %= ADLER32_BASE;
-            sum2 %= ADLER32_BASE;
-
-            len -= ADLER32_NMAX;
-        }
-
-        if (len > 0) {
-            while (len--) {
-                adler += *buf++;
-                sum2 += adler;
-            }
-
-            adler %= ADLER32_BASE;
-            sum2 %= ADLER32_BASE;
-        }
-
-        return adler | (sum2 << 16);
-    }
-
     uint32_t DexFile::ChecksumMemoryRange(const uint8_t *begin, size_t size) {
-        return adler32_(adler32_(0L, Z_NULL, 0), begin, size);
+        return base::Adler32(base::kAdler32Init, begin, size);
     }
 
     int DexFile::GetPermissions() const {
@@ -7,7 +7,12 @@
 #include "header.h"
 #include "dex/standard_dex_file.h"
 #include "dex/compact_dex_file.h"
+#include "libbase/checksum.h"
 #include "libbase/logging.h"
+#include "libbase/stringprintf.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace dex_ir {
     using namespace libdex;
@@ -641,7 +646,7 @@ namespace dex_ir {
 
     void DexWriter::WriteClassDatas(Stream *stream) {
         const uint32_t start = stream->Tell();
-        for (const std::unique_ptr<dex_ir::ClassData> &class_data :
+        for (const auto &class_data :
                 header_->ClassDatas()) {
             stream->AlignTo(SectionAlignment(DexFile::kDexTypeClassDataItem));
             ProcessOffset(stream, class_data.get());
@@ -822,7 +827,13 @@ namespace dex_ir {
 
     bool DexWriter::Write(DexContainer *output, std::string *error_msg) {
         DCHECK(error_msg != nullptr);
+        // A lazily built header only holds the class data that was accessed, decode the rest.
+        header_->MaterializeAll();
 
+        // Reserve the expected size up front instead of growing the section many times.
+        if (output->GetMainSection()->Size() == 0u) {
+            output->GetMainSection()->Resize(EstimateFileSize());
+        }
         Stream stream_storage(output->GetMainSection());
         Stream *stream = &stream_storage;
 
@@ -923,6 +934,11 @@ namespace dex_ir {
             }
             stream->Write(&link_data[0], link_data.size());
         }
+        if (stream->Failed()) {
+            *error_msg = base::StringPrintf("Failed to grow the output past %zu bytes",
+                                            output->GetMainSection()->Size());
+            return false;
+        }
 
         // Write header last.
         if (compute_offsets_) {
@@ -930,9 +946,12 @@ namespace dex_ir {
         }
         WriteHeader(stream);
 
-
-        header_->SetChecksum(DexFile::CalculateChecksum(stream->Begin(), header_->FileSize()));
-        // Rewrite the header with the calculated checksum.
+        uint32_t checksum;
+        uint8_t signature[DexFile::kSha1DigestSize];
+        ComputeChecksumAndSignature(stream->Begin(), header_->FileSize(), &checksum, signature);
+        header_->SetChecksum(checksum);
+        header_->SetSignature(signature);
+        // Rewrite the header with the calculated checksum and signature.
         WriteHeader(stream);
 
 
@@ -953,7 +972,13 @@ namespace dex_ir {
         if (*container == nullptr) {
             *container = writer->CreateDexContainer();
         }
-        return writer->Write(container->get(), error_msg);
+        if (!writer->Write(container->get(), error_msg)) {
+            return false;
+        }
+        if (compute_offsets) {
+            writer->CommitLayout();
+        }
+        return true;
     }
 
     void MapItemQueue::AddIfNotEmpty(const MapItem &item) {
@@ -986,26 +1011,479 @@ namespace dex_ir {
 
 
     bool DexWriter::Output(dex_ir::Header *header, std::string outpath) {
-        std::unique_ptr<DexWriter> writer;
-
-        writer.reset(new DexWriter(header, true));
-        std::unique_ptr<DexContainer> container = writer->CreateDexContainer();;
         std::string error_msg;
-        bool write_ = writer->Write(container.get(), &error_msg);
-        //LOGI("try write:%s", outpath.c_str());
-        FILE *file_x = fopen(outpath.c_str(), "wb");
-        uint8_t *data = container.get()->GetMainSection()->Begin();
-        if (data == nullptr)
+        if (!Output(header, outpath, &error_msg)) {
+            LOG(ERROR) << "[-]write " << outpath << " fail: " << error_msg;
             return false;
-        uint32_t len = container.get()->GetMainSection()->Size();
-        CHECK_NE(len, 0);
-        fwrite(data, 1, len, file_x);
-        fclose(file_x);
+        }
         LOG(DEBUG) << "[+]wirte:" << outpath;
-        //__android_log_print(ANDROID_LOG_ERROR, __FUNCTION__, "[+]wirte:%s", outpath.c_str());
-        return write_;
-        return false;
+        return true;
+    }
+
+    bool DexWriter::Output(dex_ir::Header *header, const std::string &outpath, std::string *error_msg) {
+        DCHECK(error_msg != nullptr);
+        DexWriter writer(header, /*compute_offsets=*/ true);
+        std::unique_ptr<FileContainer> container(
+                FileContainer::Create(outpath, writer.EstimateFileSize(), error_msg));
+        if (container == nullptr) {
+            return false;
+        }
+        if (!writer.Write(container.get(), error_msg)) {
+            if (!container->Error().empty()) {
+                *error_msg = container->Error();
+            }
+            return false;
+        }
+        if (!container->Commit(error_msg)) {
+            return false;
+        }
+        writer.CommitLayout();
+        return true;
+    }
+
+    bool DexWriter::Output(dex_ir::Header *header,
+                           uint8_t *buffer,
+                           size_t capacity,
+                           size_t *size,
+                           std::string *error_msg) {
+        DCHECK(size != nullptr);
+        DCHECK(error_msg != nullptr);
+        DexWriter writer(header, /*compute_offsets=*/ true);
+        BufferContainer container(buffer, capacity);
+        if (!writer.Write(&container, error_msg)) {
+            return false;
+        }
+        *size = container.GetMainSection()->Size();
+        if (container.Overflowed()) {
+            *error_msg = base::StringPrintf("Dex file needs %zu bytes, the buffer holds %zu", *size, capacity);
+            return false;
+        }
+        writer.CommitLayout();
+        return true;
+    }
+
+    bool DexWriter::Patch(dex_ir::Header *header,
+                          uint8_t *begin,
+                          size_t size,
+                          bool update_signature,
+                          std::string *error_msg) {
+        DCHECK(error_msg != nullptr);
+        DexWriter writer(header, /*compute_offsets=*/ false);
+        DexContainer::VectorSection data;
+        std::vector<CodeItemPatch> patches;
+        if (!writer.CollectPatches(begin, size, &data, &patches, error_msg)) {
+            return false;
+        }
+        writer.ApplyPatches(patches, data.Begin(), begin, size, update_signature);
+        return true;
+    }
+
+    bool DexWriter::OutputPatched(dex_ir::Header *header,
+                                  const std::string &source_path,
+                                  const std::string &outpath,
+                                  bool update_signature,
+                                  std::string *error_msg) {
+        DCHECK(error_msg != nullptr);
+        const int64_t size = base::OS::GetFileSizeBytes(source_path.c_str());
+        if (size < 0) {
+            *error_msg = "Failed to stat " + source_path;
+            return false;
+        }
+        base::MemMap::Init();
+        std::unique_ptr<base::File> source(base::OS::OpenFileForReading(source_path.c_str()));
+        if (source == nullptr) {
+            *error_msg = "Failed to open " + source_path;
+            return false;
+        }
+        DexWriter writer(header, /*compute_offsets=*/ false);
+        DexContainer::VectorSection data;
+        std::vector<CodeItemPatch> patches;
+        std::string patch_error;
+        bool patchable = false;
+        if (size >= static_cast<int64_t>(sizeof(StandardDexFile::Header))) {
+            // Only the pages holding the dirty items are read to check that they are still there.
+            base::MemMap source_map = base::MemMap::MapFile(static_cast<size_t>(size),
+                                                            PROT_READ,
+                                                            MAP_PRIVATE,
+                                                            source->Fd(),
+                                                            /*start=*/ 0,
+                                                            /*low_4gb=*/ false,
+                                                            source_path.c_str(),
+                                                            &patch_error);
+            patchable = source_map.IsValid() &&
+                        writer.CollectPatches(source_map.Begin(), source_map.Size(), &data, &patches,
+                                              &patch_error);
+        } else {
+            patch_error = "Too small to be a dex file";
+        }
+        if (!patchable) {
+            LOG(DEBUG) << "rewriting " << outpath << ": " << patch_error;
+            source.reset();
+            return Output(header, outpath, error_msg);
+        }
+
+        const bool in_place = source_path == outpath;
+        std::string path = outpath;
+        std::unique_ptr<base::File> file;
+        if (in_place) {
+            source.reset();
+            file.reset(base::OS::OpenFileReadWrite(path.c_str()));
+        } else {
+            file.reset(base::OS::CreateTempFileNextTo(outpath.c_str(), &path));
+            if (file != nullptr && !file->Copy(source.get(), 0, size)) {
+                *error_msg = "Failed to copy " + source_path + " to " + path + ": " + strerror(errno);
+                file->Erase(/*unlink=*/ true);
+                return false;
+            }
+        }
+        if (file == nullptr) {
+            *error_msg = "Failed to open " + path + ": " + strerror(errno);
+            return false;
+        }
+        {
+            // Only the pages holding the patched items are read and written back, unless the
+            // signature has to be recomputed.
+            base::MemMap map = base::MemMap::MapFile(static_cast<size_t>(size),
+                                                     PROT_READ | PROT_WRITE,
+                                                     MAP_SHARED,
+                                                     file->Fd(),
+                                                     /*start=*/ 0,
+                                                     /*low_4gb=*/ false,
+                                                     path.c_str(),
+                                                     error_msg);
+            if (!map.IsValid()) {
+                if (in_place) {
+                    UNUSED(file->FlushClose());
+                } else {
+                    file->Erase(/*unlink=*/ true);
+                }
+                return false;
+            }
+            writer.ApplyPatches(patches, data.Begin(), map.Begin(), map.Size(), update_signature);
+        }
+        // Never erase the source file when patching it in place.
+        if ((in_place ? file->FlushClose() : file->FlushCloseOrErase()) != 0) {
+            *error_msg = "Failed to flush " + path;
+            if (!in_place) {
+                unlink(path.c_str());
+            }
+            return false;
+        }
+        if (!in_place && rename(path.c_str(), outpath.c_str()) != 0) {
+            *error_msg = "Failed to rename " + path + " to " + outpath + ": " + strerror(errno);
+            unlink(path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool DexWriter::CollectPatches(const uint8_t *source,
+                                   size_t file_size,
+                                   DexContainer::Section *data,
+                                   std::vector<CodeItemPatch> *patches,
+                                   std::string *error_msg) {
+        if (file_size < sizeof(StandardDexFile::Header)) {
+            *error_msg = "Too small to be a dex file";
+            return false;
+        }
+        // Size everything up front, the patch costs a handful of allocations however many items changed.
+        // An item marked twice is serialized twice, the second copy finds nothing left to change.
+        const std::vector<dex_ir::CodeItem *> &code_items = header_->DirtyCodeItems();
+        const uint32_t alignment = SectionAlignment(DexFile::kDexTypeCodeItem);
+        size_t total_size = 0u;
+        for (dex_ir::CodeItem *code_item : code_items) {
+            total_size += base::RoundUp(code_item->GetSize(), alignment);
+        }
+        data->Resize(total_size);
+        patches->reserve(code_items.size());
+        // Code items are 4 byte aligned, so the try items of one written at an aligned position of the
+        // section are laid out the same as at its offset in the file.
+        Stream stream(data);
+        for (dex_ir::CodeItem *code_item : code_items) {
+            const uint32_t offset = code_item->GetSourceOffset();
+            if (offset == 0u || offset > file_size || code_item->GetSize() == 0u ||
+                code_item->GetSize() > file_size - offset) {
+                *error_msg = base::StringPrintf("Code item at %u is not part of the source file", offset);
+                return false;
+            }
+            DCHECK_EQ(offset % alignment, 0u);
+            stream.AlignTo(alignment);
+            const size_t data_offset = stream.Tell();
+            libdex::StandardDexFile::CodeItem disk_code_item;
+            disk_code_item.registers_size_ = code_item->RegistersSize();
+            disk_code_item.ins_size_ = code_item->InsSize();
+            disk_code_item.outs_size_ = code_item->OutsSize();
+            disk_code_item.tries_size_ = code_item->TriesSize();
+            disk_code_item.debug_info_off_ = code_item->GetDebugInfoOffset();
+            disk_code_item.insns_size_in_code_units_ = code_item->InsnsSize();
+            // The source offset is only right for the file the IR was built from or last written to
+            // in full, check that the item found there is this one before overwriting it.
+            libdex::StandardDexFile::CodeItem source_code_item;
+            memcpy(&source_code_item, source + offset, OFFSETOF_MEMBER(StandardDexFile::CodeItem, insns_));
+            if (source_code_item.registers_size_ != disk_code_item.registers_size_ ||
+                source_code_item.ins_size_ != disk_code_item.ins_size_ ||
+                source_code_item.outs_size_ != disk_code_item.outs_size_ ||
+                source_code_item.tries_size_ != disk_code_item.tries_size_ ||
+                source_code_item.insns_size_in_code_units_ != disk_code_item.insns_size_in_code_units_) {
+                *error_msg = base::StringPrintf("Code item at %u does not match the source file", offset);
+                return false;
+            }
+            stream.Write(&disk_code_item, OFFSETOF_MEMBER(StandardDexFile::CodeItem, insns_));
+            stream.Write(code_item->Insns(), code_item->InsnsSize() * sizeof(uint16_t));
+            WriteCodeItemPostInstructionData(&stream, code_item, /*reserve_only=*/ false);
+            const size_t size = stream.Tell() - data_offset;
+            if (size != code_item->GetSize()) {
+                *error_msg = base::StringPrintf("Code item at %u changed size from %u to %zu", offset,
+                                                code_item->GetSize(), size);
+                return false;
+            }
+            patches->push_back({offset, static_cast<uint32_t>(data_offset), static_cast<uint32_t>(size)});
+        }
+        return true;
+    }
+
+    void DexWriter::ApplyPatches(const std::vector<CodeItemPatch> &patches,
+                                 const uint8_t *data,
+                                 uint8_t *begin,
+                                 size_t size,
+                                 bool update_signature) {
+        const size_t checksum_offset = OFFSETOF_MEMBER(DexFile::Header, checksum_);
+        const size_t signature_offset = OFFSETOF_MEMBER(DexFile::Header, signature_);
+        if (!header_->ChecksumMatches()) {
+            // The checksum on disk is wrong, updating it from the patched bytes would keep it wrong.
+            for (const CodeItemPatch &patch : patches) {
+                memcpy(begin + patch.offset, data + patch.data_offset, patch.size);
+            }
+            uint32_t checksum;
+            uint8_t signature[DexFile::kSha1DigestSize];
+            ComputeChecksumAndSignature(begin, size, &checksum, signature);
+            memcpy(begin + checksum_offset, &checksum, sizeof(checksum));
+            memcpy(begin + signature_offset, signature, sizeof(signature));
+            CommitPatches(checksum, signature);
+            return;
+        }
+        uint32_t checksum;
+        memcpy(&checksum, begin + checksum_offset, sizeof(checksum));
+        // Replaces |count| bytes at |offset| with |data|, writing only the span that differs.
+        auto replace = [&](size_t offset, const uint8_t *data, size_t count) {
+            size_t first = 0u;
+            while (first < count && begin[offset + first] == data[first]) {
+                ++first;
+            }
+            size_t last = count;
+            while (last > first && begin[offset + last - 1] == data[last - 1]) {
+                --last;
+            }
+            if (first == last) {
+                return;
+            }
+            uint8_t *target = begin + offset + first;
+            const size_t length = last - first;
+            checksum = base::Adler32Replace(checksum,
+                                            base::Adler32(base::kAdler32Init, target, length),
+                                            base::Adler32(base::kAdler32Init, data + first, length),
+                                            size - offset - last);
+            memcpy(target, data + first, length);
+        };
+        for (const CodeItemPatch &patch : patches) {
+            replace(patch.offset, data + patch.data_offset, patch.size);
+        }
+        if (update_signature) {
+            const size_t signature_end = signature_offset + DexFile::kSha1DigestSize;
+            base::Sha1 sha1;
+            sha1.Update(begin + signature_end, size - signature_end);
+            uint8_t signature[DexFile::kSha1DigestSize];
+            sha1.Finish(signature);
+            replace(signature_offset, signature, DexFile::kSha1DigestSize);
+        }
+        memcpy(begin + checksum_offset, &checksum, sizeof(checksum));
+        CommitPatches(checksum, begin + signature_offset);
+    }
+
+    void DexWriter::CommitPatches(uint32_t checksum, const uint8_t *signature) {
+        header_->SetChecksum(checksum);
+        header_->SetSignature(signature);
+        header_->SetChecksumMatches(true);
+        header_->ClearDirty();
     }
 
+    void DexWriter::CommitLayout() {
+        for (auto &code_item : header_->CodeItems()) {
+            code_item->SetSourceOffset(code_item->GetOffset());
+            code_item->SetDebugInfoOffset(code_item->DebugInfo() == nullptr
+                                          ? 0u
+                                          : code_item->DebugInfo()->GetOffset());
+        }
+        header_->SetChecksumMatches(true);
+        header_->ClearDirty();
+    }
+
+    void DexWriter::ComputeChecksumAndSignature(const uint8_t *begin,
+                                                size_t size,
+                                                uint32_t *checksum,
+                                                uint8_t *signature) {
+        // The signature covers everything after it and the checksum everything after itself, so one
+        // pass feeds both and the checksum of the signature is put in front with Adler32Combine.
+        // Chunks keep the data in cache between the two.
+        static constexpr size_t kChunkSize = 64 * 1024;
+        const size_t signature_end = OFFSETOF_MEMBER(DexFile::Header, signature_) + DexFile::kSha1DigestSize;
+        CHECK_GE(size, signature_end);
+        base::Sha1 sha1;
+        uint32_t adler = base::kAdler32Init;
+        for (size_t offset = signature_end; offset < size; offset += kChunkSize) {
+            const size_t count = std::min(kChunkSize, size - offset);
+            sha1.Update(begin + offset, count);
+            adler = base::Adler32(adler, begin + offset, count);
+        }
+        sha1.Finish(signature);
+        const uint32_t signature_adler = base::Adler32(base::kAdler32Init, signature, DexFile::kSha1DigestSize);
+        *checksum = base::Adler32Combine(signature_adler, adler, size - signature_end);
+    }
+
+    size_t DexWriter::EstimateFileSize() const {
+        // Offsets are only assigned while writing, so the exact size is not known up front. Edits
+        // rarely grow a file by more than an eighth, past that the section is remapped. Without a
+        // parsed file start with a few pages.
+        const size_t size = header_->FileSize();
+        return base::RoundUp(std::max<size_t>(size + size / 8, 16 * base::kPageSize), base::kPageSize);
+    }
+
+    DexWriter::BufferContainer::BufferContainer(uint8_t *buffer, size_t capacity)
+            : main_section_(buffer, capacity) {}
+
+    DexWriter::BufferContainer::BufferSection::BufferSection(uint8_t *buffer, size_t capacity)
+            : buffer_(buffer), capacity_(capacity), size_(capacity) {
+        // The writer relies on unwritten bytes being zero.
+        memset(buffer_, 0, capacity_);
+    }
+
+    void DexWriter::BufferContainer::BufferSection::Resize(size_t size) {
+        if (!overflowed_ && size > capacity_) {
+            heap_.assign(buffer_, buffer_ + size_);
+            overflowed_ = true;
+        }
+        if (overflowed_) {
+            heap_.resize(size, 0u);
+            return;
+        }
+        if (size > size_) {
+            memset(buffer_ + size_, 0, size - size_);
+        }
+        size_ = size;
+    }
+
+    void DexWriter::BufferContainer::BufferSection::Clear() {
+        heap_.clear();
+        size_ = 0u;
+    }
+
+    DexWriter::FileContainer *DexWriter::FileContainer::Create(const std::string &path,
+                                                               size_t capacity,
+                                                               std::string *error_msg) {
+        base::MemMap::Init();
+        std::string temp_path;
+        base::File *file = base::OS::CreateTempFileNextTo(path.c_str(), &temp_path);
+        if (file == nullptr) {
+            *error_msg = "Failed to create a temporary file for " + path + ": " + strerror(errno);
+            return nullptr;
+        }
+        std::unique_ptr<FileContainer> container(new FileContainer(path, temp_path, file));
+        capacity = base::RoundUp(std::max<size_t>(capacity, 1u), base::kPageSize);
+        if (!container->main_section_.Map(capacity, error_msg)) {
+            return nullptr;
+        }
+        // The new file reads as zeros, the writer can use all of it right away.
+        container->main_section_.size_ = capacity;
+        container->main_section_.dirty_end_ = capacity;
+        return container.release();
+    }
+
+    DexWriter::FileContainer::FileContainer(const std::string &path,
+                                            const std::string &temp_path,
+                                            base::File *file)
+            : path_(path), temp_path_(temp_path), file_(file) {
+        main_section_.file_ = file;
+        main_section_.path_ = temp_path_.c_str();
+    }
+
+    DexWriter::FileContainer::~FileContainer() {
+        main_section_.map_.Reset();
+        if (file_ != nullptr) {
+            file_->Erase(/*unlink=*/ true);
+        }
+    }
+
+    bool DexWriter::FileContainer::Commit(std::string *error_msg) {
+        CHECK(file_ != nullptr);
+        if (!main_section_.error_.empty()) {
+            *error_msg = main_section_.error_;
+            return false;
+        }
+        const size_t size = main_section_.Size();
+        main_section_.map_.Reset();
+        if (ftruncate(file_->Fd(), size) != 0) {
+            *error_msg = "Failed to truncate " + temp_path_ + ": " + strerror(errno);
+            return false;
+        }
+        // Flushing syncs the pages written through the mapping as well and reports write back errors.
+        if (file_->FlushCloseOrErase() != 0) {
+            *error_msg = "Failed to flush " + temp_path_;
+            file_.reset();
+            unlink(temp_path_.c_str());
+            return false;
+        }
+        file_.reset();
+        if (rename(temp_path_.c_str(), path_.c_str()) != 0) {
+            *error_msg = "Failed to rename " + temp_path_ + " to " + path_ + ": " + strerror(errno);
+            unlink(temp_path_.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool DexWriter::FileContainer::FileSection::Map(size_t capacity, std::string *error_msg) {
+        // Reserve the blocks so running out of space fails here and not as a fault in the writer.
+        const int result = posix_fallocate(file_->Fd(), 0, capacity);
+        if (result != 0) {
+            *error_msg = base::StringPrintf("Failed to reserve %zu bytes for %s: %s", capacity, path_,
+                                            strerror(result));
+            return false;
+        }
+        base::MemMap map = base::MemMap::MapFile(capacity,
+                                                 PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED,
+                                                 file_->Fd(),
+                                                 /*start=*/ 0,
+                                                 /*low_4gb=*/ false,
+                                                 path_,
+                                                 error_msg);
+        if (!map.IsValid()) {
+            return false;
+        }
+        map_ = std::move(map);
+        return true;
+    }
+
+    void DexWriter::FileContainer::FileSection::Resize(size_t size) {
+        if (!error_.empty()) {
+            return;
+        }
+        if (size > map_.Size()) {
+            const size_t capacity = base::RoundUp(std::max(size, map_.Size() + map_.Size() / 2), base::kPageSize);
+            if (!Map(capacity, &error_)) {
+                // Keep the old mapping and size, the stream sees it did not grow and stops writing.
+                return;
+            }
+        }
+        if (size > size_ && size_ < dirty_end_) {
+            memset(map_.Begin() + size_, 0, std::min(size, dirty_end_) - size_);
+        }
+        size_ = size;
+        dirty_end_ = std::max(dirty_end_, size_);
+    }
+
+    void DexWriter::FileContainer::FileSection::Clear() {
+        size_ = 0u;
+    }
 
 }
\ No newline at end of file
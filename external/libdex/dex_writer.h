@@ -11,6 +11,9 @@
 #include "libbase/leb128.h"
 #include "dex/dex_file.h"
 #include "libbase/macros.h"
+#include "libbase/mem_map.h"
+#include "libbase/fd_file.h"
+#include "libbase/os.h"
 #include "dex_container.h"
 #include "annotation.h"
 #include "field_item.h"
@@ -78,7 +81,9 @@ namespace dex_ir {
             ALWAYS_INLINE size_t
 
             Write(const void *buffer, size_t length) {
-                EnsureStorage(length);
+                if (!EnsureStorage(length)) {
+                    return length;
+                }
                 for (size_t i = 0; i < length; ++i) {
                     DCHECK_EQ(data_[position_ + i], 0u);
                 }
@@ -90,20 +95,26 @@ namespace dex_ir {
             ALWAYS_INLINE size_t
 
             Overwrite(const void *buffer, size_t length) {
-                EnsureStorage(length);
+                if (!EnsureStorage(length)) {
+                    return length;
+                }
                 memcpy(&data_[position_], buffer, length);
                 position_ += length;
                 return length;
             }
 
             ALWAYS_INLINE size_t Clear(size_t position, size_t length) {
-                EnsureStorage(length);
+                if (!EnsureStorage(length)) {
+                    return length;
+                }
                 memset(&data_[position], 0, length);
                 return length;
             }
 
             ALWAYS_INLINE size_t WriteSleb128(int32_t value) {
-                EnsureStorage(8);
+                if (!EnsureStorage(8)) {
+                    return 0u;
+                }
                 uint8_t *ptr = &data_[position_];
                 const size_t len = base::EncodeSignedLeb128(ptr, value) - ptr;
                 position_ += len;
@@ -111,7 +122,9 @@ namespace dex_ir {
             }
 
             ALWAYS_INLINE size_t WriteUleb128(uint32_t value) {
-                EnsureStorage(8);
+                if (!EnsureStorage(8)) {
+                    return 0u;
+                }
                 uint8_t *ptr = &data_[position_];
                 const size_t len = base::EncodeUnsignedLeb128(ptr, value) - ptr;
                 position_ += len;
@@ -128,6 +141,12 @@ namespace dex_ir {
                 EnsureStorage(0u);
             }
 
+            // Set once the section failed to grow. Every write is dropped from then on and the writer
+            // gives up before the header is written.
+            bool Failed() const {
+                return failed_;
+            }
+
             class ScopedSeek {
             public:
                 ScopedSeek(Stream *stream, uint32_t offset) : stream_(stream), offset_(stream->Tell()) {
@@ -144,12 +163,15 @@ namespace dex_ir {
             };
 
         private:
-            ALWAYS_INLINE void EnsureStorage(size_t length) {
+            ALWAYS_INLINE bool EnsureStorage(size_t length) {
                 size_t end = position_ + length;
-                while (UNLIKELY(end > data_size_)) {
+                while (UNLIKELY(end > data_size_ && !failed_)) {
+                    const size_t old_size = data_size_;
                     section_->Resize(data_size_ * 3 / 2 + 1);
                     SyncWithSection();
+                    failed_ = data_size_ <= old_size;
                 }
+                return !failed_;
             }
 
             void SyncWithSection() {
@@ -164,6 +186,7 @@ namespace dex_ir {
             uint8_t *data_ = nullptr;
             // Cached Size from the container to provide faster accesses.
             size_t data_size_ = 0u;
+            bool failed_ = false;
         };
 
         static inline constexpr uint32_t SectionAlignment(libdex::DexFile::MapItemType type) {
@@ -202,6 +225,123 @@ namespace dex_ir {
             friend class CompactDexWriter;
         };
 
+        // Container writing into a caller supplied buffer. When the dex file outgrows the buffer the
+        // content moves to the heap and Overflowed() reports it.
+        class BufferContainer : public DexContainer {
+        public:
+            BufferContainer(uint8_t *buffer, size_t capacity);
+
+            Section *GetMainSection() override {
+                return &main_section_;
+            }
+
+            Section *GetDataSection() override {
+                return &data_section_;
+            }
+
+            bool IsCompactDexContainer() const override {
+                return false;
+            }
+
+            bool Overflowed() const {
+                return main_section_.overflowed_;
+            }
+
+        private:
+            class BufferSection : public Section {
+            public:
+                BufferSection(uint8_t *buffer, size_t capacity);
+
+                uint8_t *Begin() override {
+                    return overflowed_ ? heap_.data() : buffer_;
+                }
+
+                size_t Size() const override {
+                    return overflowed_ ? heap_.size() : size_;
+                }
+
+                void Resize(size_t size) override;
+
+                void Clear() override;
+
+                uint8_t *const buffer_;
+                const size_t capacity_;
+                size_t size_;
+                bool overflowed_ = false;
+                std::vector<uint8_t> heap_;
+            };
+
+            BufferSection main_section_;
+            VectorSection data_section_;
+        };
+
+        // Container writing through a shared mapping of a uniquely named temporary file next to the
+        // output path, so the dex file is never copied through the heap. The file is reserved up front
+        // with EstimateFileSize() and grown by remapping when the output turns out larger; Commit()
+        // trims it to the written size and renames it.
+        class FileContainer : public DexContainer {
+        public:
+            static FileContainer *Create(const std::string &path, size_t capacity, std::string *error_msg);
+
+            ~FileContainer() override;
+
+            Section *GetMainSection() override {
+                return &main_section_;
+            }
+
+            Section *GetDataSection() override {
+                return &data_section_;
+            }
+
+            bool IsCompactDexContainer() const override {
+                return false;
+            }
+
+            // Writes the main section to disk and moves the file to its final path.
+            bool Commit(std::string *error_msg);
+
+            // Why the file could not be grown, empty while it never failed.
+            const std::string &Error() const {
+                return main_section_.error_;
+            }
+
+        private:
+            class FileSection : public Section {
+            public:
+                uint8_t *Begin() override {
+                    return map_.Begin();
+                }
+
+                size_t Size() const override {
+                    return size_;
+                }
+
+                void Resize(size_t size) override;
+
+                void Clear() override;
+
+                // Maps |capacity| bytes of the file after reserving them on disk.
+                bool Map(size_t capacity, std::string *error_msg);
+
+                base::File *file_ = nullptr;
+                const char *path_ = nullptr;
+                base::MemMap map_;
+                size_t size_ = 0u;
+                // Bytes past this offset have never been handed to the writer and are still zero.
+                size_t dirty_end_ = 0u;
+                // Growing the file failed, the size stays put so the writer stops.
+                std::string error_;
+            };
+
+            FileContainer(const std::string &path, const std::string &temp_path, base::File *file);
+
+            const std::string path_;
+            const std::string temp_path_;
+            std::unique_ptr<base::File> file_;
+            FileSection main_section_;
+            VectorSection data_section_;
+        };
+
         DexWriter(DexLayout *dex_layout, bool compute_offsets);
 
         DexWriter(dex_ir::Header *header, bool compute_offsets);
@@ -214,6 +354,47 @@ namespace dex_ir {
         static bool Output(dex_ir::Header *header,
                            std::string outpath) WARN_UNUSED;
 
+        // Writes the dex file straight into |outpath| through a mapped temporary file.
+        static bool Output(dex_ir::Header *header,
+                           const std::string &outpath,
+                           std::string *error_msg) WARN_UNUSED;
+
+        // Writes the dex file into |buffer| and sets |size| to its size. Fails when it does not fit, in
+        // which case |size| is the capacity needed.
+        static bool Output(dex_ir::Header *header,
+                           uint8_t *buffer,
+                           size_t capacity,
+                           size_t *size,
+                           std::string *error_msg) WARN_UNUSED;
+
+        // Rewrites the code items marked dirty in |header| into |begin|, the dex file the header was
+        // built from or last written to in full, without touching the rest: only the bytes that
+        // differ are written and the checksum is updated from them alone. The signature needs a pass
+        // over the whole file and is only recomputed with |update_signature|; both are recomputed
+        // when the checksum of the parsed file was wrong. Fails and leaves the file untouched when a
+        // dirty item no longer fits its original range or is not found there.
+        static bool Patch(dex_ir::Header *header,
+                          uint8_t *begin,
+                          size_t size,
+                          bool update_signature,
+                          std::string *error_msg) WARN_UNUSED;
+
+        // Writes |header| to |outpath| by patching a copy of |source_path|, the file it was built
+        // from or last written to in full, or the file itself when both paths are the same. Falls
+        // back to a full Output when the dirty items cannot be patched.
+        static bool OutputPatched(dex_ir::Header *header,
+                                  const std::string &source_path,
+                                  const std::string &outpath,
+                                  bool update_signature,
+                                  std::string *error_msg) WARN_UNUSED;
+
+        // Computes the checksum and SHA-1 signature of a dex file whose bytes past the signature are
+        // final, reading them once.
+        static void ComputeChecksumAndSignature(const uint8_t *begin,
+                                                size_t size,
+                                                uint32_t *checksum,
+                                                uint8_t *signature);
+
 
         virtual ~DexWriter() {}
         virtual std::unique_ptr<DexContainer> CreateDexContainer() const;
@@ -240,6 +421,10 @@ namespace dex_ir {
 
         virtual size_t GetHeaderSize() const;
 
+        // Size to reserve for the output: an estimate, the size of the parsed file with some room to
+        // grow, not the laid out size.
+        size_t EstimateFileSize() const;
+
         // reserve_only means don't write, only reserve space. This is required since the string data
         // offsets must be assigned.
         void WriteStringIds(Stream *stream, bool reserve_only);
@@ -306,6 +491,38 @@ namespace dex_ir {
         bool compute_offsets_;
 
     private:
+        struct CodeItemPatch {
+            // Offset in the dex file and in the section holding the serialized items.
+            uint32_t offset;
+            uint32_t data_offset;
+            uint32_t size;
+        };
+
+        // Serializes every dirty code item into |data| for its source offset in |source|, a file of
+        // |file_size| bytes. Fails when one of them changed size or the code item header found at its
+        // offset in |source| is not its own.
+        bool CollectPatches(const uint8_t *source,
+                            size_t file_size,
+                            DexContainer::Section *data,
+                            std::vector<CodeItemPatch> *patches,
+                            std::string *error_msg);
+
+        // Writes the patches into |begin| and updates the checksum from the changed bytes, or
+        // recomputes checksum and signature over the whole file when the parsed checksum was wrong.
+        void ApplyPatches(const std::vector<CodeItemPatch> &patches,
+                          const uint8_t *data,
+                          uint8_t *begin,
+                          size_t size,
+                          bool update_signature);
+
+        // Records the checksum and signature of the patched file and forgets the dirty items.
+        void CommitPatches(uint32_t checksum, const uint8_t *signature);
+
+        // Called once a full write reached its output: the new layout becomes the source of later
+        // patches, so code items take their new and debug info offsets as source offsets and nothing
+        // is dirty.
+        void CommitLayout();
+
         DISALLOW_COPY_AND_ASSIGN(DexWriter);
     };
 
@@ -26,10 +26,14 @@ namespace dex_ir {
     }
 
     void FieldId::AddMethodRefs(uint32_t id) {
-        this->method_ref_idx.insert(id);
+        this->method_ref_idx.Insert(id);
     }
 
-    std::set<uint32_t> FieldId::GetMethodRefs() const {
+    void FieldId::SetMethodRefs(base::ArrayRef<const uint32_t> ids) {
+        this->method_ref_idx.SetView(ids);
+    }
+
+    const RefSet &FieldId::GetMethodRefs() const {
         return this->method_ref_idx;
     }
 }
\ No newline at end of file
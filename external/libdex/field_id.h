@@ -9,6 +9,7 @@
 #include "dexir_util.h"
 #include "type_id.h"
 #include "string_id.h"
+#include "ref_set.h"
 
 namespace dex_ir {
     class FieldId : public IndexedItem {
@@ -28,14 +29,16 @@ namespace dex_ir {
         //void Accept(AbstractDispatcher *dispatch) const { dispatch->Dispatch(this); }
         void AddMethodRefs(uint32_t id);
 
-        std::set<uint32_t> GetMethodRefs() const;
+        void SetMethodRefs(base::ArrayRef<const uint32_t> ids);
+
+        const RefSet &GetMethodRefs() const;
 
     private:
         const TypeId *class_;
         const TypeId *type_;
         const StringId *name_;
 
-        std::set<uint32_t> method_ref_idx;
+        RefSet method_ref_idx;
         DISALLOW_COPY_AND_ASSIGN(FieldId);
     };
 
@@ -9,6 +9,10 @@
 #include "builder_maps.h"
 #include "decompilation.h"
 #include "dex/standard_dex_file.h"
+#include <sys/mman.h>
+#include <libbase/fd_file.h>
+#include <libbase/os.h>
+#include <libbase/stringprintf.h>
 
 namespace dex_ir {
     static uint32_t GetDebugInfoStreamSize_(const uint8_t *debug_info_stream) {
@@ -59,9 +63,7 @@ namespace dex_ir {
         }
     }
 
-    dex_ir::Header *DexIrBuilder(const libdex::DexFile &dex_file,
-                                 bool eagerly_assign_offsets) {
-
+    static Header *CreateHeader(const libdex::DexFile &dex_file) {
         const libdex::DexFile::Header &disk_header = dex_file.GetHeader();
         Header *header = new Header(disk_header.magic_,
                                     disk_header.checksum_,
@@ -80,12 +82,24 @@ namespace dex_ir {
                                     dex_file.NumFieldIds(),
                                     dex_file.NumMethodIds(),
                                     dex_file.NumClassDefs());
-        BuilderMaps builder_maps(header, eagerly_assign_offsets);
+        header->SetChecksumMatches(dex_file.CalculateChecksum() == disk_header.checksum_);
+        return header;
+    }
+
+    static void BuildHeader(const libdex::DexFile &dex_file,
+                            Header *header,
+                            BuilderMaps &builder_maps,
+                            base::ThreadPool *thread_pool) {
+        const libdex::DexFile::Header &disk_header = dex_file.GetHeader();
         // Walk the rest of the header fields.
         // StringId table.
         header->StringIds().SetOffset(disk_header.string_ids_off_);
-        for (uint32_t i = 0; i < dex_file.NumStringIds(); ++i) {
-            builder_maps.CreateStringId(dex_file, i);
+        if (thread_pool != nullptr) {
+            builder_maps.CreateStringIds(dex_file, thread_pool);
+        } else {
+            for (uint32_t i = 0; i < dex_file.NumStringIds(); ++i) {
+                builder_maps.CreateStringId(dex_file, i);
+            }
         }
         // TypeId table.
         header->TypeIds().SetOffset(disk_header.type_ids_off_);
@@ -107,8 +121,12 @@ namespace dex_ir {
         for (uint32_t i = 0; i < dex_file.NumMethodIds(); ++i) {
             builder_maps.CreateMethodId(dex_file, i);
         }
-        // ClassDef table.
+        // ClassDef table. The parallel build decodes the class data up front, the serial walk below then
+        // finds it in the builder maps.
         header->ClassDefs().SetOffset(disk_header.class_defs_off_);
+        if (thread_pool != nullptr) {
+            builder_maps.CreateClassDatas(dex_file, thread_pool);
+        }
         for (uint32_t i = 0; i < dex_file.NumClassDefs(); ++i) {
             builder_maps.CreateClassDef(dex_file, i);
         }
@@ -126,9 +144,167 @@ namespace dex_ir {
                 dex_file.DataBegin() + dex_file.GetHeader().link_off_,
                 dex_file.DataBegin() + dex_file.GetHeader().link_off_ + dex_file.GetHeader().link_size_));
         header->SetUpDecompilation();
+    }
+
+    dex_ir::Header *DexIrBuilder(const libdex::DexFile &dex_file,
+                                 bool eagerly_assign_offsets,
+                                 size_t thread_count) {
+        Header *header = CreateHeader(dex_file);
+        BuilderMaps builder_maps(header, eagerly_assign_offsets);
+        std::unique_ptr<base::ThreadPool> thread_pool;
+        if (thread_count > 1) {
+            thread_pool.reset(new base::ThreadPool(thread_count));
+        }
+        BuildHeader(dex_file, header, builder_maps, thread_pool.get());
+        return header;
+    }
+
+    dex_ir::Header *DexIrLazyBuilder(const std::string &dex_path, std::string *error_msg) {
+        base::MemMap::Init();
+        std::unique_ptr<base::File> file(base::OS::OpenFileForReading(dex_path.c_str()));
+        if (file == nullptr) {
+            *error_msg = "Failed to open " + dex_path;
+            return nullptr;
+        }
+        int64_t length = file->GetLength();
+        if (length < static_cast<int64_t>(sizeof(libdex::DexFile::Header))) {
+            *error_msg = "Too small to be a dex file: " + dex_path;
+            return nullptr;
+        }
+        // A private writable mapping: untouched pages are never read in, and code that patches
+        // instructions in place only copies the pages it writes to.
+        base::MemMap mem_map = base::MemMap::MapFile(static_cast<size_t>(length),
+                                                     PROT_READ | PROT_WRITE,
+                                                     MAP_PRIVATE,
+                                                     file->Fd(),
+                                                     /*start=*/ 0,
+                                                     /*low_4gb=*/ false,
+                                                     dex_path.c_str(),
+                                                     error_msg);
+        if (!mem_map.IsValid()) {
+            return nullptr;
+        }
+        std::unique_ptr<libdex::DexFile> dex_file(
+                libdex::DexFile::getDexFile(mem_map.Begin(), static_cast<size_t>(length)));
+        if (!dex_file->IsMagicValid() || !dex_file->IsVersionValid()) {
+            *error_msg = "Not a dex file: " + dex_path;
+            return nullptr;
+        }
+        Header *header = CreateHeader(*dex_file);
+        LazyLoader *lazy_loader = new LazyLoader(header, std::move(mem_map), std::move(dex_file));
+        header->SetLazyLoader(lazy_loader);
+        BuildHeader(lazy_loader->GetDexFile(), header, lazy_loader->GetBuilderMaps(), nullptr);
         return header;
     }
 
+    void Header::SetLazyLoader(LazyLoader *lazy_loader) {
+        lazy_loader_.reset(lazy_loader);
+    }
+
+    void Header::MaterializeAll() {
+        if (lazy_loader_ != nullptr) {
+            lazy_loader_->LoadAll();
+        }
+    }
+
+    void Header::SetUpAllocator() {
+        string_ids_.SetAllocator(&allocator_);
+        type_ids_.SetAllocator(&allocator_);
+        proto_ids_.SetAllocator(&allocator_);
+        field_ids_.SetAllocator(&allocator_);
+        method_ids_.SetAllocator(&allocator_);
+        class_defs_.SetAllocator(&allocator_);
+        call_site_ids_.SetAllocator(&allocator_);
+        method_handle_items_.SetAllocator(&allocator_);
+        string_datas_.SetAllocator(&allocator_);
+        type_lists_.SetAllocator(&allocator_);
+        encoded_array_items_.SetAllocator(&allocator_);
+        annotation_items_.SetAllocator(&allocator_);
+        annotation_set_items_.SetAllocator(&allocator_);
+        annotation_set_ref_lists_.SetAllocator(&allocator_);
+        annotations_directory_items_.SetAllocator(&allocator_);
+        hiddenapi_class_datas_.SetAllocator(&allocator_);
+        debug_info_items_.SetAllocator(&allocator_);
+        code_items_.SetAllocator(&allocator_);
+        class_datas_.SetAllocator(&allocator_);
+    }
+
+    template<class T>
+    static size_t MethodRefsMemoryUsage(const CollectionVector<T> &items) {
+        size_t bytes = 0;
+        for (const auto &item : items) {
+            bytes += item->GetMethodRefs().MemoryUsage();
+        }
+        return bytes;
+    }
+
+    static void DumpMemoryUsageLine(std::ostream &os, const char *kind, size_t count, size_t item_bytes,
+                                    size_t ref_bytes) {
+        os << base::StringPrintf("%-26s %10zu items %12zu bytes %12zu ref bytes\n",
+                                 kind, count, item_bytes, ref_bytes);
+    }
+
+    template<class T>
+    static void DumpMemoryUsageLine(std::ostream &os, const char *kind, const CollectionVector<T> &items,
+                                    size_t ref_bytes = 0) {
+        DumpMemoryUsageLine(os, kind, items.Size(), items.Size() * sizeof(T), ref_bytes);
+    }
+
+    void Header::DumpMemoryUsage(std::ostream &os) const {
+        DumpMemoryUsageLine(os, "StringId", string_ids_, MethodRefsMemoryUsage(string_ids_));
+        DumpMemoryUsageLine(os, "TypeId", type_ids_, MethodRefsMemoryUsage(type_ids_));
+        DumpMemoryUsageLine(os, "ProtoId", proto_ids_);
+        DumpMemoryUsageLine(os, "FieldId", field_ids_, MethodRefsMemoryUsage(field_ids_));
+        DumpMemoryUsageLine(os, "MethodId", method_ids_, MethodRefsMemoryUsage(method_ids_));
+        DumpMemoryUsageLine(os, "ClassDef", class_defs_);
+        DumpMemoryUsageLine(os, "CallSiteId", call_site_ids_);
+        DumpMemoryUsageLine(os, "MethodHandleItem", method_handle_items_);
+        DumpMemoryUsageLine(os, "StringData", string_datas_);
+        DumpMemoryUsageLine(os, "TypeList", type_lists_);
+        DumpMemoryUsageLine(os, "EncodedArrayItem", encoded_array_items_);
+        DumpMemoryUsageLine(os, "AnnotationItem", annotation_items_);
+        DumpMemoryUsageLine(os, "AnnotationSetItem", annotation_set_items_);
+        DumpMemoryUsageLine(os, "AnnotationSetRefList", annotation_set_ref_lists_);
+        DumpMemoryUsageLine(os, "AnnotationsDirectoryItem", annotations_directory_items_);
+        DumpMemoryUsageLine(os, "HiddenapiClassData", hiddenapi_class_datas_);
+        DumpMemoryUsageLine(os, "DebugInfoItem", debug_info_items_);
+        DumpMemoryUsageLine(os, "CodeItem", code_items_);
+        DumpMemoryUsageLine(os, "ClassData", class_datas_);
+        // Method items are owned by their class data and allocated on the heap.
+        size_t method_ref_bytes = 0;
+        for (const auto &entry : method_items_) {
+            const MethodItem *method_item = entry.second;
+            method_ref_bytes += method_item->GetMethodRefs().MemoryUsage() +
+                                method_item->GetStringRefs().MemoryUsage() +
+                                method_item->GetTypeRefs().MemoryUsage() +
+                                method_item->GetFieldRefs().MemoryUsage();
+        }
+        DumpMemoryUsageLine(os, "MethodItem", method_items_.size(), method_items_.size() * sizeof(MethodItem),
+                            method_ref_bytes);
+        os << base::StringPrintf("arena: %zu bytes used, %zu bytes reserved in %zu blocks\n",
+                                 allocator_.BytesUsed(), allocator_.BytesAllocated(), allocator_.NumBlocks());
+    }
+
+    MethodItem *Header::GetMethodItem(uint32_t method_idx) {
+        auto it = method_items_.find(method_idx);
+        if (it == method_items_.end() && lazy_loader_ != nullptr && method_idx < method_ids_.Size()) {
+            ClassDef *class_def = lazy_loader_->FindClassDef(method_ids_[method_idx]->Class()->GetIndex());
+            if (class_def != nullptr && !class_def->ClassDataLoaded()) {
+                class_def->GetClassData();
+                it = method_items_.find(method_idx);
+            }
+        }
+        return it != method_items_.end() ? it->second : nullptr;
+    }
+
+    void Header::SetXrefIndex(XrefIndex *xref_index) {
+        xref_index_.reset(xref_index);
+    }
+
+    void Header::SetSymbolIndex(SymbolIndex *symbol_index) {
+        symbol_index_.reset(symbol_index);
+    }
+
     void Header::SetUpDecompilation() {
         this->decompilation_ = new Decompilation(this);
     }
@@ -6,6 +6,7 @@
 #define BASE_HEADER_H
 
 #include <string.h>
+#include <ostream>
 #include "dex/dex_file.h"
 #include "item.h"
 #include "dexir_util.h"
@@ -28,6 +29,9 @@
 #include "debug_info_item.h"
 #include "code_item.h"
 #include "hiddenapi_class_data.h"
+#include "lazy_loader.h"
+#include "xref_index.h"
+#include "symbol_index.h"
 
 
 namespace dex_ir {
@@ -123,6 +127,13 @@ namespace dex_ir {
 
         void SetChecksum(uint32_t new_checksum) { checksum_ = new_checksum; }
 
+        // Whether Checksum() is the Adler-32 of the file the header was built from or last written
+        // to. Repaired or dumped dex files often carry a stale one, DexWriter::Patch then recomputes
+        // it instead of updating it.
+        bool ChecksumMatches() const { return checksum_matches_; }
+
+        void SetChecksumMatches(bool checksum_matches) { checksum_matches_ = checksum_matches; }
+
         void SetSignature(const uint8_t *new_signature) {
             memcpy(signature_, new_signature, sizeof(signature_));
         }
@@ -258,14 +269,51 @@ namespace dex_ir {
         std::map<uint32_t, MethodItem *> &
         MethodItems() { return method_items_; }
 
+        // The method item of method |method_idx|, decoding the class data that defines it on a lazy
+        // header. nullptr for methods defined in other dex files.
+        MethodItem *GetMethodItem(uint32_t method_idx);
+
         uint32_t MethodItemsSize() const {
             return method_items_.size();
         }
 
         void SetUpDecompilation();
 
+        // Takes ownership of the loader of a Header built by DexIrLazyBuilder.
+        void SetLazyLoader(LazyLoader *lazy_loader);
+
+        bool IsLazy() const { return lazy_loader_ != nullptr; }
+
+        LazyLoader *GetLazyLoader() const { return lazy_loader_.get(); }
+
+        // Decodes all class data deferred by DexIrLazyBuilder. Until then ClassDatas(), CodeItems(),
+        // DebugInfoItems() and MethodItems() only hold what was accessed through ClassDef::GetClassData.
+        void MaterializeAll();
+
+        base::ArenaAllocator &GetAllocator() { return allocator_; }
+
+        // Writes the number of items and the bytes they use for every IR kind, including the
+        // reference sets filled by Decompilation::loadReferences, followed by the arena totals.
+        void DumpMemoryUsage(std::ostream &os) const;
+
         Decompilation *GetDecompilation();
 
+        // Takes ownership of the index that the ref sets of the items point into.
+        void SetXrefIndex(XrefIndex *xref_index);
+
+        const XrefIndex *GetXrefIndex() const { return xref_index_.get(); }
+
+        void SetSymbolIndex(SymbolIndex *symbol_index);
+
+        const SymbolIndex *GetSymbolIndex() const { return symbol_index_.get(); }
+
+        // Records that |code_item| was edited in place, so DexWriter::Patch can rewrite just that item.
+        void MarkDirty(CodeItem *code_item) { dirty_code_items_.push_back(code_item); }
+
+        const std::vector<CodeItem *> &DirtyCodeItems() const { return dirty_code_items_; }
+
+        void ClearDirty() { dirty_code_items_.clear(); }
+
         CodeItem *CreateCodeItem(const libdex::DexFile &dex_file, uint8_t *data, uint32_t off_in_dex,
                                  uint32_t dex_id_index);
 
@@ -302,8 +350,22 @@ namespace dex_ir {
             data_offset_ = data_offset;
             memcpy(magic_, magic, sizeof(magic_));
             memcpy(signature_, signature, sizeof(signature_));
+            SetUpAllocator();
         }
 
+        void SetUpAllocator();
+
+        // Declared before the collections so the mapping outlives the items that point into it.
+        std::unique_ptr<LazyLoader> lazy_loader_;
+
+        // Rows viewed by the Get*Refs() sets of the items below.
+        std::unique_ptr<XrefIndex> xref_index_;
+
+        std::unique_ptr<SymbolIndex> symbol_index_;
+
+        // Backs every item of the collection vectors below, which must be destroyed first.
+        base::ArenaAllocator allocator_;
+
         // Collection vectors own the IR data.
         IndexedCollectionVector<StringId> string_ids_;
         IndexedCollectionVector<TypeId> type_ids_;
@@ -334,14 +396,25 @@ namespace dex_ir {
 
         // Link data.
         std::vector<uint8_t> link_data_;
-        Decompilation *decompilation_;
+        // Code items edited since the last write, may hold duplicates.
+        std::vector<CodeItem *> dirty_code_items_;
+        bool checksum_matches_ = false;
+        Decompilation *decompilation_ = nullptr;
 
     private:
         DISALLOW_COPY_AND_ASSIGN(Header);
     };
 
+    // Builds the IR of |dex_file|. With a thread_count above one the string data, class data, code
+    // items and debug info are decoded on a thread pool; the result is identical to the serial build.
     dex_ir::Header *DexIrBuilder(const libdex::DexFile &dex_file,
-                                 bool eagerly_assign_offsets);
+                                 bool eagerly_assign_offsets,
+                                 size_t thread_count = 1);
+
+    // Maps the dex file at |dex_path| instead of reading it. Strings, code and debug info point into
+    // the mapping and class data is only decoded on first access, so the cost of a job scales with
+    // what it touches. Returns nullptr and sets |error_msg| on failure.
+    dex_ir::Header *DexIrLazyBuilder(const std::string &dex_path, std::string *error_msg);
 }
 
 #endif //BASE_HEADER_H
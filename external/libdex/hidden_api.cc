@@ -16,62 +16,310 @@
 
 #include "hidden_api.h"
 
-#include <fstream>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 
-#include "libbase/stringuitls.h"
+#include "libbase/fd_file.h"
+#include "libbase/os.h"
 #include "dex/dex_file-inl.h"
 
 namespace dex_ir {
 
-HiddenApi::HiddenApi(const char* filename, bool sdk_uses_only) {
+namespace {
+
+constexpr uint8_t kHiddenApiMagic[8] = {'h', 'i', 'd', 'd', 'e', 'n', 'a', '\0'};
+constexpr uint32_t kHiddenApiVersion = 1;
+
+// Header of the binary form. It is followed by the entries, the buckets and the names.
+struct HiddenApiFileHeader {
+  uint8_t magic[8];
+  uint32_t version;
+  uint32_t file_size;
+  uint32_t num_entries;
+  uint32_t num_buckets;
+  uint32_t entries_offset;
+  uint32_t buckets_offset;
+  uint32_t names_offset;
+  uint32_t names_size;
+};
+
+// FNV-1a, stable across builds unlike std::hash.
+uint32_t Hash(const char* data, size_t length) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 1099511628211ull;
+  }
+  return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// Flags of an entry that is not in the lists for one value of `sdk_uses_only`.
+const uint32_t kNoFlags = libdex::hiddenapi::ApiList().GetDexFlags();
+
+bool IsValidFlags(uint32_t flags) {
+  using libdex::hiddenapi::ApiList;
+  const uint32_t value = flags & ApiList::kValueBitMask;
+  return (flags >> (ApiList::kValueBitSize + ApiList::kDomainApiCount)) == 0 &&
+         (value < ApiList::kValueCount || flags == kNoFlags);
+}
+
+}  // namespace
+
+HiddenApi::HiddenApi(const char* filename, bool sdk_uses_only) : sdk_uses_only_(sdk_uses_only ? 1u : 0u) {
   CHECK(filename != nullptr);
 
-  std::ifstream in(filename);
-  for (std::string str; std::getline(in, str);) {
-    std::vector<std::string> values = base::Split(str, ",");
-    const std::string& signature = values[0];
-    libdex::hiddenapi::ApiList membership;
-    bool success =  libdex::hiddenapi::ApiList::FromNames(values.begin() + 1, values.end(), &membership);
-    CHECK(success) << "Unknown ApiList flag: " << str;
-    CHECK(membership.IsValid()) << "Invalid ApiList: " << membership;
+  std::string error_msg;
+  base::MemMap::Init();
+  std::unique_ptr<base::File> file(base::OS::OpenFileForReading(filename));
+  int64_t length = (file != nullptr) ? file->GetLength() : 0;
+  base::MemMap mem_map;
+  if (length > 0) {
+    mem_map = base::MemMap::MapFile(static_cast<size_t>(length),
+                                    PROT_READ,
+                                    MAP_PRIVATE,
+                                    file->Fd(),
+                                    /*start=*/ 0,
+                                    /*low_4gb=*/ false,
+                                    filename,
+                                    &error_msg);
+    CHECK(mem_map.IsValid()) << error_msg;
+  }
+  if (mem_map.IsValid() && mem_map.Size() >= sizeof(kHiddenApiMagic) &&
+      memcmp(mem_map.Begin(), kHiddenApiMagic, sizeof(kHiddenApiMagic)) == 0) {
+    CHECK(SetUpTable(mem_map.Begin(), mem_map.Size(), &error_msg)) << filename << ": " << error_msg;
+    mem_map_ = std::move(mem_map);
+    return;
+  }
+  // Like reading from a std::ifstream, a missing file gives empty lists.
+  ParseCsv(mem_map.IsValid()
+               ? std::string_view(reinterpret_cast<const char*>(mem_map.Begin()), mem_map.Size())
+               : std::string_view());
+  CHECK(SetUpTable(storage_.data(), storage_.size(), &error_msg)) << error_msg;
+}
 
-    if (sdk_uses_only != membership.Contains( libdex::hiddenapi::ApiList::Whitelist())) {
-      // Either we want only SDK uses and this is not a whitelist entry,
-      // or we want only non-SDK uses and this is a whitelist entry.
-      continue;
+void HiddenApi::ParseCsv(std::string_view content) {
+  struct Signature {
+    std::string_view name;
+    uint32_t flags[2];
+  };
+  std::vector<Signature> signatures;
+  std::unordered_map<std::string_view, uint32_t> indices;
+  // Same merging as a std::map per value of `sdk_uses_only`: the most restrictive list wins.
+  auto add_signature = [&](std::string_view signature, libdex::hiddenapi::ApiList membership, size_t column) {
+    auto it = indices.emplace(signature, static_cast<uint32_t>(signatures.size()));
+    if (it.second) {
+      signatures.push_back({signature, {kNoFlags, kNoFlags}});
+    }
+    uint32_t& flags = signatures[it.first->second].flags[column];
+    if (flags == kNoFlags ||
+        membership.GetMaxAllowedSdkVersion() <
+            libdex::hiddenapi::ApiList(flags).GetMaxAllowedSdkVersion()) {
+      flags = membership.GetDexFlags();
+    }
+  };
+
+  // Tokens are assigned in place so their buffers are reused from line to line.
+  std::vector<std::string> values;
+  size_t line_begin = 0;
+  while (line_begin < content.size()) {
+    size_t line_end = content.find('\n', line_begin);
+    if (line_end == std::string_view::npos) {
+      line_end = content.size();
     }
+    std::string_view line = content.substr(line_begin, line_end - line_begin);
+    line_begin = line_end + 1;
+
+    size_t num_values = 0;
+    for (size_t base = 0;;) {
+      size_t found = line.find(',', base);
+      if (num_values == values.size()) {
+        values.emplace_back();
+      }
+      values[num_values++].assign(line.substr(base, found - base));
+      if (found == std::string_view::npos) {
+        break;
+      }
+      base = found + 1;
+    }
+    std::string_view signature = line.substr(0, values[0].size());
+    libdex::hiddenapi::ApiList membership;
+    bool success = libdex::hiddenapi::ApiList::FromNames(
+        values.begin() + 1, values.begin() + num_values, &membership);
+    CHECK(success) << "Unknown ApiList flag: " << line;
+    CHECK(membership.IsValid()) << "Invalid ApiList: " << membership;
 
-    AddSignatureToApiList(signature, membership);
+    // Whitelist entries are only kept when reporting SDK uses, the others only when not.
+    const size_t column = membership.Contains(libdex::hiddenapi::ApiList::Whitelist()) ? 1u : 0u;
+    add_signature(signature, membership, column);
     size_t pos = signature.find("->");
-    if (pos != std::string::npos) {
+    if (pos != std::string_view::npos) {
       // Add the class name.
-      AddSignatureToApiList(signature.substr(0, pos), membership);
+      add_signature(signature.substr(0, pos), membership, column);
       pos = signature.find('(');
-      if (pos != std::string::npos) {
+      if (pos != std::string_view::npos) {
         // Add the class->method name (so stripping the signature).
-        AddSignatureToApiList(signature.substr(0, pos), membership);
+        add_signature(signature.substr(0, pos), membership, column);
       }
       pos = signature.find(':');
-      if (pos != std::string::npos) {
+      if (pos != std::string_view::npos) {
         // Add the class->field name (so stripping the type).
-        AddSignatureToApiList(signature.substr(0, pos), membership);
+        add_signature(signature.substr(0, pos), membership, column);
       }
     }
   }
+
+  // Lay the table out as in the binary form. Buckets hold entry index + 1, 0 when empty, and
+  // there are always more buckets than entries so a probe ends.
+  const uint32_t num_entries = static_cast<uint32_t>(signatures.size());
+  uint32_t num_buckets = 1;
+  while (num_buckets <= num_entries * 2) {
+    num_buckets <<= 1;
+  }
+  size_t names_size = 0;
+  for (const Signature& signature : signatures) {
+    names_size += signature.name.size();
+  }
+  HiddenApiFileHeader file_header;
+  memset(&file_header, 0, sizeof(file_header));
+  memcpy(file_header.magic, kHiddenApiMagic, sizeof(kHiddenApiMagic));
+  file_header.version = kHiddenApiVersion;
+  file_header.num_entries = num_entries;
+  file_header.num_buckets = num_buckets;
+  file_header.entries_offset = sizeof(HiddenApiFileHeader);
+  file_header.buckets_offset = file_header.entries_offset + num_entries * sizeof(Entry);
+  file_header.names_offset = file_header.buckets_offset + num_buckets * sizeof(uint32_t);
+  file_header.names_size = static_cast<uint32_t>(names_size);
+  file_header.file_size = file_header.names_offset + file_header.names_size;
+
+  storage_.assign(file_header.file_size, 0u);
+  memcpy(storage_.data(), &file_header, sizeof(file_header));
+  Entry* entries = reinterpret_cast<Entry*>(storage_.data() + file_header.entries_offset);
+  uint32_t* buckets = reinterpret_cast<uint32_t*>(storage_.data() + file_header.buckets_offset);
+  char* names = reinterpret_cast<char*>(storage_.data() + file_header.names_offset);
+  uint32_t name_offset = 0;
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    const Signature& signature = signatures[i];
+    Entry& entry = entries[i];
+    entry.hash = Hash(signature.name.data(), signature.name.size());
+    entry.name_offset = name_offset;
+    entry.name_length = static_cast<uint32_t>(signature.name.size());
+    entry.flags[0] = signature.flags[0];
+    entry.flags[1] = signature.flags[1];
+    memcpy(names + name_offset, signature.name.data(), signature.name.size());
+    name_offset += entry.name_length;
+    uint32_t bucket = entry.hash & (num_buckets - 1);
+    while (buckets[bucket] != 0) {
+      bucket = (bucket + 1) & (num_buckets - 1);
+    }
+    buckets[bucket] = i + 1;
+  }
+}
+
+bool HiddenApi::SetUpTable(const uint8_t* data, size_t size, std::string* error_msg) {
+  if (size < sizeof(HiddenApiFileHeader)) {
+    *error_msg = "Too small to be a hidden API list";
+    return false;
+  }
+  const HiddenApiFileHeader* file_header = reinterpret_cast<const HiddenApiFileHeader*>(data);
+  if (memcmp(file_header->magic, kHiddenApiMagic, sizeof(kHiddenApiMagic)) != 0 ||
+      file_header->version != kHiddenApiVersion ||
+      file_header->file_size != size) {
+    *error_msg = "Not a hidden API list or unsupported version";
+    return false;
+  }
+  const uint64_t num_entries = file_header->num_entries;
+  const uint64_t num_buckets = file_header->num_buckets;
+  if (num_buckets <= num_entries || (num_buckets & (num_buckets - 1)) != 0 ||
+      file_header->entries_offset % sizeof(uint32_t) != 0 ||
+      file_header->buckets_offset % sizeof(uint32_t) != 0 ||
+      file_header->entries_offset + num_entries * sizeof(Entry) > size ||
+      file_header->buckets_offset + num_buckets * sizeof(uint32_t) > size ||
+      static_cast<uint64_t>(file_header->names_offset) + file_header->names_size > size) {
+    *error_msg = "Malformed hidden API list";
+    return false;
+  }
+  const Entry* entries = reinterpret_cast<const Entry*>(data + file_header->entries_offset);
+  const uint32_t* buckets = reinterpret_cast<const uint32_t*>(data + file_header->buckets_offset);
+  for (uint64_t i = 0; i < num_entries; ++i) {
+    const Entry& entry = entries[i];
+    if (static_cast<uint64_t>(entry.name_offset) + entry.name_length > file_header->names_size ||
+        !IsValidFlags(entry.flags[0]) || !IsValidFlags(entry.flags[1])) {
+      *error_msg = "Malformed hidden API list entry";
+      return false;
+    }
+  }
+  // Every entry sits in exactly one bucket. With more buckets than entries some bucket stays empty,
+  // which is what ends a probe for a missing name.
+  std::vector<bool> bucketed(num_entries, false);
+  uint64_t num_used_buckets = 0;
+  for (uint64_t i = 0; i < num_buckets; ++i) {
+    if (buckets[i] == 0) {
+      continue;
+    }
+    if (buckets[i] > num_entries || bucketed[buckets[i] - 1]) {
+      *error_msg = "Malformed hidden API list bucket";
+      return false;
+    }
+    bucketed[buckets[i] - 1] = true;
+    ++num_used_buckets;
+  }
+  if (num_used_buckets != num_entries) {
+    *error_msg = "Malformed hidden API list bucket";
+    return false;
+  }
+  data_ = data;
+  size_ = size;
+  names_ = reinterpret_cast<const char*>(data + file_header->names_offset);
+  entries_ = entries;
+  buckets_ = buckets;
+  num_buckets_ = file_header->num_buckets;
+  return true;
 }
 
-void HiddenApi::AddSignatureToApiList(const std::string& signature,  libdex::hiddenapi::ApiList membership) {
-  auto it = api_list_.find(signature);
-  if (it == api_list_.end()) {
-    // Does not exist yet. Add it to list.
-    api_list_.emplace(signature, membership);
-  } else if (membership.GetMaxAllowedSdkVersion() < it->second.GetMaxAllowedSdkVersion()) {
-    // Already exist but `membership` is more restrictive.
-    it->second = membership;
-  } else {
-    // Already exists and `membership` is equally or less restrictive.
+libdex::hiddenapi::ApiList HiddenApi::GetApiList(const std::string& name) const {
+  const uint32_t hash = Hash(name.data(), name.size());
+  for (uint32_t bucket = hash & (num_buckets_ - 1);; bucket = (bucket + 1) & (num_buckets_ - 1)) {
+    const uint32_t index = buckets_[bucket];
+    if (index == 0) {
+      return libdex::hiddenapi::ApiList();
+    }
+    const Entry& entry = entries_[index - 1];
+    if (entry.hash == hash && entry.name_length == name.size() &&
+        memcmp(names_ + entry.name_offset, name.data(), name.size()) == 0) {
+      return libdex::hiddenapi::ApiList(entry.flags[sdk_uses_only_]);
+    }
+  }
+}
+
+bool HiddenApi::WriteBinary(const std::string& path, std::string* error_msg) const {
+  std::string temp_path;
+  std::unique_ptr<base::File> file(base::OS::CreateTempFileNextTo(path.c_str(), &temp_path));
+  if (file == nullptr) {
+    *error_msg = "Failed to create a temporary file for " + path;
+    return false;
+  }
+  if (!file->WriteFully(data_, size_)) {
+    *error_msg = "Failed to write " + temp_path;
+    file->Erase(/*unlink=*/ true);
+    return false;
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    *error_msg = "Failed to flush " + temp_path;
+    unlink(temp_path.c_str());
+    return false;
+  }
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    *error_msg = "Failed to rename " + temp_path + " to " + path + ": " + strerror(errno);
+    unlink(temp_path.c_str());
+    return false;
   }
+  return true;
 }
 
 std::string HiddenApi::GetApiMethodName(const libdex::DexFile& dex_file, uint32_t method_index) {
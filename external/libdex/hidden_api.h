@@ -23,7 +23,10 @@
 #include <map>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "dex/hiddenapi_flags.h"
+#include "libbase/mem_map.h"
 
 namespace dex_ir {
 
@@ -31,15 +34,16 @@ class DexFile;
 
 /**
  * Helper class for logging if a method/field is in a hidden API list.
+ *
+ * The lists are kept in an open addressing hash table. `flags_file` is either the
+ * hiddenapi-flags.csv text form or the binary form written by WriteBinary, which holds the
+ * table itself and is mapped and looked up in place.
  */
 class HiddenApi {
  public:
   HiddenApi(const char* flags_file, bool sdk_uses_only);
 
-    libdex::hiddenapi::ApiList GetApiList(const std::string& name) const {
-    auto it = api_list_.find(name);
-    return (it == api_list_.end()) ? libdex::hiddenapi::ApiList() : it->second;
-  }
+  libdex::hiddenapi::ApiList GetApiList(const std::string& name) const;
 
   bool IsInAnyList(const std::string& name) const {
     return !GetApiList(name).IsEmpty();
@@ -59,10 +63,34 @@ class HiddenApi {
     return "L" + val + ";";
   }
 
- private:
-  void AddSignatureToApiList(const std::string& signature, libdex::hiddenapi::ApiList membership);
+  // Writes the lists for both values of `sdk_uses_only` in the binary form, through a temporary
+  // file that is renamed on success.
+  bool WriteBinary(const std::string& path, std::string* error_msg) const;
 
-  std::map<std::string, libdex::hiddenapi::ApiList> api_list_;
+ private:
+  // Table entry, laid out the same in memory and in the binary form.
+  struct Entry {
+    uint32_t hash;
+    uint32_t name_offset;
+    uint32_t name_length;
+    // Dex flags of the entry for both values of `sdk_uses_only`.
+    uint32_t flags[2];
+  };
+
+  void ParseCsv(std::string_view content);
+
+  bool SetUpTable(const uint8_t* data, size_t size, std::string* error_msg);
+
+  size_t sdk_uses_only_;
+  // The binary form, either built from the CSV form in `storage_` or mapped in `mem_map_`.
+  std::vector<uint8_t> storage_;
+  base::MemMap mem_map_;
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  const char* names_ = nullptr;
+  const Entry* entries_ = nullptr;
+  const uint32_t* buckets_ = nullptr;
+  uint32_t num_buckets_ = 0;
 };
 
 struct HiddenApiStats {
@@ -11,7 +11,7 @@ namespace dex_ir {
     template<class T>
     class IndexedCollectionVector : public CollectionVector<T> {
     public:
-        using Vector = std::vector<std::unique_ptr<T>>;
+        using Vector = std::vector<typename CollectionVector<T>::ElementType>;
 
         IndexedCollectionVector() = default;
 
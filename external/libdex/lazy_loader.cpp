@@ -0,0 +1,58 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include "lazy_loader.h"
+#include "header.h"
+
+namespace dex_ir {
+
+    LazyLoader::LazyLoader(Header *header, base::MemMap &&mem_map, std::unique_ptr<libdex::DexFile> dex_file)
+            : header_(header),
+              mem_map_(std::move(mem_map)),
+              dex_file_(std::move(dex_file)),
+              builder_maps_(header, /*eagerly_assign_offsets=*/ false, this) {}
+
+    LazyLoader::~LazyLoader() {
+    }
+
+    ClassData *LazyLoader::LoadClassData(ClassDef *class_def) {
+        const libdex::dex::ClassDef &disk_class_def = dex_file_->GetClassDef(class_def->GetIndex());
+        ClassData *class_data = builder_maps_.CreateClassData(*dex_file_, disk_class_def);
+        if (class_data != nullptr) {
+            class_data->SetClassDef(class_def);
+            // Class data decoded after loadReferences still gets its refs.
+            if (header_->GetXrefIndex() != nullptr) {
+                for (auto &method : *class_data->DirectMethods()) {
+                    header_->GetXrefIndex()->FillRefs(method.get());
+                }
+                for (auto &method : *class_data->VirtualMethods()) {
+                    header_->GetXrefIndex()->FillRefs(method.get());
+                }
+            }
+        }
+        ++loaded_count_;
+        return class_data;
+    }
+
+    ClassDef *LazyLoader::FindClassDef(uint32_t type_idx) {
+        if (class_defs_by_type_.empty()) {
+            class_defs_by_type_.resize(header_->TypeIds().Size(), nullptr);
+            for (auto &class_def : header_->ClassDefs()) {
+                class_defs_by_type_[class_def->ClassType()->GetIndex()] = class_def.get();
+            }
+        }
+        return type_idx < class_defs_by_type_.size() ? class_defs_by_type_[type_idx] : nullptr;
+    }
+
+    void LazyLoader::LoadAll() {
+        if (all_loaded_) {
+            return;
+        }
+        for (auto &class_def : header_->ClassDefs()) {
+            class_def->GetClassData();
+        }
+        builder_maps_.SortVectorsByMapOrder();
+        all_loaded_ = true;
+    }
+}
@@ -0,0 +1,54 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_LAZY_LOADER_H
+#define BASE_LAZY_LOADER_H
+
+#include <memory>
+#include <libbase/mem_map.h>
+#include "dex/dex_file.h"
+#include "builder_maps.h"
+#include "class_def.h"
+
+namespace dex_ir {
+    class Header;
+
+    // Owns the mapping, the DexFile and the builder maps behind a Header built by DexIrLazyBuilder,
+    // and decodes class data when a ClassDef asks for it. Not thread safe, like the rest of the IR.
+    class LazyLoader : public ClassDataLoader {
+    public:
+        LazyLoader(Header *header, base::MemMap &&mem_map, std::unique_ptr<libdex::DexFile> dex_file);
+
+        ~LazyLoader() override;
+
+        const libdex::DexFile &GetDexFile() const { return *dex_file_; }
+
+        BuilderMaps &GetBuilderMaps() { return builder_maps_; }
+
+        ClassData *LoadClassData(ClassDef *class_def) override;
+
+        // Decode every deferred class data and sort the collections back to the map order, so the
+        // Header looks the same as an eagerly built one.
+        void LoadAll();
+
+        // The class def of the class with type index |type_idx|, or nullptr if the dex does not define it.
+        ClassDef *FindClassDef(uint32_t type_idx);
+
+        // Number of class defs whose class data was decoded so far.
+        uint32_t LoadedClassDataCount() const { return loaded_count_; }
+
+    private:
+        Header *header_;
+        base::MemMap mem_map_;
+        std::unique_ptr<libdex::DexFile> dex_file_;
+        BuilderMaps builder_maps_;
+        std::vector<ClassDef *> class_defs_by_type_;
+        uint32_t loaded_count_ = 0;
+        bool all_loaded_ = false;
+
+        DISALLOW_COPY_AND_ASSIGN(LazyLoader);
+    };
+}
+
+#endif //BASE_LAZY_LOADER_H
@@ -8,6 +8,7 @@
 #include "indexed_item.h"
 #include "type_id.h"
 #include "proto_id.h"
+#include "ref_set.h"
 
 namespace dex_ir {
     class MethodId : public IndexedItem {
@@ -27,10 +28,14 @@ namespace dex_ir {
 
         //void Accept(AbstractDispatcher *dispatch) const { dispatch->Dispatch(this); }
         void AddMethodRefs(uint32_t id) {
-            this->method_ref_idx.insert(id);
+            this->method_ref_idx.Insert(id);
         }
 
-        std::set<uint32_t> GetMethodRefs() const {
+        void SetMethodRefs(base::ArrayRef<const uint32_t> ids) {
+            this->method_ref_idx.SetView(ids);
+        }
+
+        const RefSet &GetMethodRefs() const {
             return this->method_ref_idx;
         }
 
@@ -39,7 +44,7 @@ namespace dex_ir {
         const ProtoId *proto_;
         const StringId *name_;
         //value=method index id
-        std::set<uint32_t> method_ref_idx;
+        RefSet method_ref_idx;
         DISALLOW_COPY_AND_ASSIGN(MethodId);
     };
 }
@@ -54,39 +54,55 @@ namespace dex_ir {
     }
 
     void MethodItem::AddMethodRef(uint32_t id) {
-        this->method_ref_idx.insert(id);
+        this->method_ref_idx.Insert(id);
     }
 
     void MethodItem::AddStringRef(uint32_t id) {
-        this->string_ref_idx.insert(id);
+        this->string_ref_idx.Insert(id);
     }
 
     void MethodItem::AddTypeRef(uint32_t id) {
-        this->type_ref_idx.insert(id);
+        this->type_ref_idx.Insert(id);
     }
 
     void MethodItem::AddFieldRef(uint32_t raw_id) {
-        this->field_ref_idx.insert(raw_id);
+        this->field_ref_idx.Insert(raw_id);
+    }
+
+    void MethodItem::SetMethodRefs(base::ArrayRef<const uint32_t> ids) {
+        this->method_ref_idx.SetView(ids);
+    }
+
+    void MethodItem::SetStringRefs(base::ArrayRef<const uint32_t> ids) {
+        this->string_ref_idx.SetView(ids);
+    }
+
+    void MethodItem::SetTypeRefs(base::ArrayRef<const uint32_t> ids) {
+        this->type_ref_idx.SetView(ids);
+    }
+
+    void MethodItem::SetFieldRefs(base::ArrayRef<const uint32_t> ids) {
+        this->field_ref_idx.SetView(ids);
     }
 
     std::string MethodItem::GetJavaClassName() const {
         return this->GetClassData()->GetClassDef()->getJavaClassName();
     }
 
-    std::set<uint32_t> MethodItem::GetMethodRefs() const {
+    const RefSet &MethodItem::GetMethodRefs() const {
         return this->method_ref_idx;
     }
 
-    std::set<uint32_t> MethodItem::GetStringRefs() const {
+    const RefSet &MethodItem::GetStringRefs() const {
         return this->string_ref_idx;
     }
 
-    std::set<uint32_t> MethodItem::GetTypeRefs() const {
+    const RefSet &MethodItem::GetTypeRefs() const {
         return this->type_ref_idx;
     }
 
-    std::set<uint32_t> MethodItem::GetFieldRefs() const {
-        return type_ref_idx;
+    const RefSet &MethodItem::GetFieldRefs() const {
+        return this->field_ref_idx;
     }
 
     MethodItem::MethodItem(uint32_t access_flags, const MethodId *method_id, CodeItem *code, uint32_t raw_index)
@@ -8,6 +8,7 @@
 #include "item.h"
 #include "method_id.h"
 #include "code_item.h"
+#include "ref_set.h"
 
 namespace dex_ir {
     class ClassData;
@@ -58,20 +59,29 @@ namespace dex_ir {
 
         void AddMethodRef(uint32_t raw_id);
 
+        // Set*Refs keep a view of |ids|, see RefSet::SetView.
+        void SetMethodRefs(base::ArrayRef<const uint32_t> ids);
+
         /**调用了那些方法*/
-        std::set<uint32_t> GetMethodRefs() const;
+        const RefSet &GetMethodRefs() const;
 
         void AddStringRef(uint32_t raw_id);
 
-        std::set<uint32_t> GetStringRefs() const;
+        void SetStringRefs(base::ArrayRef<const uint32_t> ids);
+
+        const RefSet &GetStringRefs() const;
 
         void AddTypeRef(uint32_t raw_id);
 
-        std::set<uint32_t> GetTypeRefs() const;
+        void SetTypeRefs(base::ArrayRef<const uint32_t> ids);
+
+        const RefSet &GetTypeRefs() const;
 
         void AddFieldRef(uint32_t raw_id);
 
-        std::set<uint32_t> GetFieldRefs() const;
+        void SetFieldRefs(base::ArrayRef<const uint32_t> ids);
+
+        const RefSet &GetFieldRefs() const;
 
         //void Accept(AbstractDispatcher* dispatch) { dispatch->Dispatch(this); }
 
@@ -81,10 +91,10 @@ namespace dex_ir {
         CodeItem *code_;  // This can be nullptr.
         ClassData *classData_ = nullptr;
         uint32_t raw_method_index;
-        std::set<uint32_t> method_ref_idx;
-        std::set<uint32_t> string_ref_idx;
-        std::set<uint32_t> type_ref_idx;
-        std::set<uint32_t> field_ref_idx;
+        RefSet method_ref_idx;
+        RefSet string_ref_idx;
+        RefSet type_ref_idx;
+        RefSet field_ref_idx;
         DISALLOW_COPY_AND_ASSIGN(MethodItem);
     };
 
@@ -0,0 +1,83 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_REF_SET_H
+#define BASE_REF_SET_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <libbase/array_ref.h>
+
+namespace dex_ir {
+    // Set of raw ids, e.g. the methods that reference an id item, kept as a sorted vector so an entry
+    // costs four bytes instead of a std::set node. Ids found in ascending order are appended, others
+    // are inserted in place. Iteration is in ascending order like std::set and reads never modify the
+    // set, so any number of threads may read it as long as none inserts.
+    // A set can also be a view of sorted, unique ids owned elsewhere, see SetView.
+    class RefSet {
+    public:
+        using const_iterator = const uint32_t *;
+
+        RefSet() = default;
+
+        RefSet(RefSet &&) = default;
+
+        RefSet &operator=(RefSet &&) = default;
+
+        void Insert(uint32_t id) {
+            if (view_ != nullptr) {
+                ids_.assign(view_, view_ + view_size_);
+                view_ = nullptr;
+                view_size_ = 0;
+            }
+            if (ids_.empty() || ids_.back() < id) {
+                ids_.push_back(id);
+                return;
+            }
+            auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+            if (*it != id) {
+                ids_.insert(it, id);
+            }
+        }
+
+        // Use |ids|, which must be sorted, unique and outlive the set, without copying them. Falls
+        // back to Insert when the set is not empty.
+        void SetView(base::ArrayRef<const uint32_t> ids) {
+            if (view_ == nullptr && ids_.empty()) {
+                view_ = ids.data();
+                view_size_ = ids.size();
+                return;
+            }
+            for (uint32_t id : ids) {
+                Insert(id);
+            }
+        }
+
+        size_t count(uint32_t id) const {
+            return std::binary_search(begin(), end(), id) ? 1u : 0u;
+        }
+
+        size_t size() const { return end() - begin(); }
+
+        bool empty() const { return view_size_ == 0 && ids_.empty(); }
+
+        const_iterator begin() const {
+            return view_ != nullptr ? view_ : ids_.data();
+        }
+
+        const_iterator end() const {
+            return view_ != nullptr ? view_ + view_size_ : ids_.data() + ids_.size();
+        }
+
+        size_t MemoryUsage() const { return ids_.capacity() * sizeof(uint32_t); }
+
+    private:
+        std::vector<uint32_t> ids_;
+        const uint32_t *view_ = nullptr;
+        uint32_t view_size_ = 0;
+    };
+}
+
+#endif //BASE_REF_SET_H
@@ -0,0 +1,435 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include "register_dataflow.h"
+
+#include <algorithm>
+#include <deque>
+#include "code_item.h"
+#include "dex/bytecode_utils.h"
+#include "dex/dex_instruction-inl.h"
+
+namespace dex_ir {
+    using libdex::Instruction;
+
+    namespace {
+        constexpr uint32_t kNoInsn = 0xffffffffu;
+
+        // Marks the successors reached by an exception, which see the registers as they were before
+        // the throwing instruction.
+        constexpr uint32_t kExceptionalEdge = 0x80000000u;
+
+        // Chains of moves are followed at most this deep when resolving a value.
+        constexpr int kMaxMoveDepth = 32;
+
+        // Longer runs of straight code are cut into several blocks so a query replays at most this
+        // many instructions.
+        constexpr size_t kMaxBlockInsns = 64;
+
+        enum ResolveState : uint8_t {
+            kUnresolved,
+            kResolving,
+            kResolved,
+        };
+
+        // Whether |instruction| writes its vA register, which is the only one any instruction writes.
+        bool WritesRegisterA(const Instruction &instruction) {
+            const Instruction::Code opcode = instruction.Opcode();
+            return (opcode >= Instruction::MOVE && opcode <= Instruction::MOVE_EXCEPTION) ||
+                   (opcode >= Instruction::CONST_4 && opcode <= Instruction::CONST_CLASS) ||
+                   (opcode >= Instruction::INSTANCE_OF && opcode <= Instruction::NEW_ARRAY) ||
+                   (opcode >= Instruction::CMPL_FLOAT && opcode <= Instruction::CMP_LONG) ||
+                   (opcode >= Instruction::AGET && opcode <= Instruction::AGET_SHORT) ||
+                   (opcode >= Instruction::IGET && opcode <= Instruction::IGET_SHORT) ||
+                   (opcode >= Instruction::SGET && opcode <= Instruction::SGET_SHORT) ||
+                   (opcode >= Instruction::NEG_INT && opcode <= Instruction::USHR_INT_LIT8) ||
+                   (opcode >= Instruction::IGET_QUICK && opcode <= Instruction::IGET_OBJECT_QUICK) ||
+                   (opcode >= Instruction::IGET_BOOLEAN_QUICK && opcode <= Instruction::IGET_SHORT_QUICK) ||
+                   opcode == Instruction::CONST_METHOD_HANDLE ||
+                   opcode == Instruction::CONST_METHOD_TYPE;
+        }
+
+        // Calls visit(target_pc) for the targets of a branch or switch instruction, the same ones
+        // VeriFlowAnalysis::FindBranches marks. Switches with a payload outside the code are skipped.
+        template<typename Visitor>
+        void VisitBranchTargets(const Instruction &instruction, uint32_t dex_pc, uint32_t insns_size,
+                                Visitor &&visit) {
+            if (instruction.IsBranch()) {
+                visit(static_cast<int64_t>(dex_pc) + instruction.GetTargetOffset());
+            } else if (instruction.IsSwitch()) {
+                const int32_t payload_offset = instruction.VRegB_31t();
+                const int64_t payload_pc = static_cast<int64_t>(dex_pc) + payload_offset;
+                if (payload_pc < 0 || payload_pc + 2 > insns_size) {
+                    return;
+                }
+                const uint16_t *payload = reinterpret_cast<const uint16_t *>(&instruction) + payload_offset;
+                const bool sparse = instruction.Opcode() == Instruction::SPARSE_SWITCH;
+                const uint16_t signature = sparse ? Instruction::kSparseSwitchSignature
+                                                  : Instruction::kPackedSwitchSignature;
+                const int64_t payload_size = sparse ? 2 + payload[1] * 4 : 4 + payload[1] * 2;
+                if (payload[0] != signature || payload_pc + payload_size > insns_size) {
+                    return;
+                }
+                libdex::DexSwitchTable table(instruction, dex_pc);
+                for (libdex::DexSwitchTableIterator s_it(table); !s_it.Done(); s_it.Advance()) {
+                    visit(static_cast<int64_t>(dex_pc) + s_it.CurrentTargetOffset());
+                }
+            }
+        }
+    }
+
+    RegisterDataflow::RegisterDataflow(const CodeItem *code_item)
+            : registers_size_(code_item->RegistersSize()) {
+        const uint16_t *insns = code_item->Insns();
+        const uint32_t insns_size = code_item->InsnsSize();
+        for (uint32_t reg = 0; reg < registers_size_; ++reg) {
+            defs_.push_back({kEntryPc, static_cast<uint16_t>(reg), false});
+        }
+
+        // Decode the instructions and number their definitions.
+        std::vector<uint32_t> insn_at(insns_size, kNoInsn);
+        for (const libdex::DexInstructionPcPair &inst : code_item->Instructions()) {
+            const uint32_t pc = inst.DexPc();
+            const uint32_t width = inst->SizeInCodeUnits();
+            if (width == 0 || width > insns_size - pc) {
+                break;
+            }
+            uint32_t def = kNoDef;
+            if (WritesRegisterA(inst.Inst())) {
+                const uint32_t reg = inst->VRegA();
+                const bool wide = (Instruction::VerifyFlagsOf(inst->Opcode()) & Instruction::kVerifyRegAWide) != 0;
+                if (reg + (wide ? 1u : 0u) < registers_size_) {
+                    def = defs_.size();
+                    defs_.push_back({pc, static_cast<uint16_t>(reg), wide});
+                }
+            }
+            insn_at[pc] = insns_.size();
+            insns_.push_back({pc, def});
+        }
+        const size_t num_insns = insns_.size();
+
+        reg_def_offsets_.assign(registers_size_ + 1u, 0u);
+        for (const Def &def : defs_) {
+            ++reg_def_offsets_[def.reg + 1u];
+            if (def.wide) {
+                ++reg_def_offsets_[def.reg + 2u];
+            }
+        }
+        for (uint32_t reg = 0; reg < registers_size_; ++reg) {
+            reg_def_offsets_[reg + 1u] += reg_def_offsets_[reg];
+        }
+        reg_defs_.resize(reg_def_offsets_[registers_size_]);
+        std::vector<uint32_t> reg_fill(reg_def_offsets_.begin(), reg_def_offsets_.end() - 1);
+        for (uint32_t def = 0; def < defs_.size(); ++def) {
+            reg_defs_[reg_fill[defs_[def].reg]++] = def;
+            if (defs_[def].wide) {
+                reg_defs_[reg_fill[defs_[def].reg + 1u]++] = def;
+            }
+        }
+        if (num_insns == 0) {
+            return;
+        }
+
+        auto insn_index = [&](int64_t pc) -> uint32_t {
+            return pc >= 0 && pc < insns_size ? insn_at[pc] : kNoInsn;
+        };
+        // The try item covering every instruction, tries never overlap.
+        std::vector<const TryItem *> insn_try(num_insns, nullptr);
+        if (code_item->Tries() != nullptr) {
+            for (const auto &try_item : *code_item->Tries()) {
+                const uint32_t end = try_item->StartAddr() + try_item->InsnCount();
+                for (size_t i = FindInsn(try_item->StartAddr()); i < num_insns && insns_[i].pc < end; ++i) {
+                    insn_try[i] = try_item.get();
+                }
+            }
+        }
+        auto visit_handlers = [&](const TryItem *try_item, auto &&visit) {
+            if (try_item == nullptr || try_item->GetHandlers() == nullptr) {
+                return;
+            }
+            for (const auto &handler : *try_item->GetHandlers()->GetHandlers()) {
+                uint32_t target = insn_index(handler->GetAddress());
+                if (target != kNoInsn) {
+                    visit(target);
+                }
+            }
+        };
+
+        // Split the code into blocks.
+        std::vector<bool> leaders(num_insns + 1u, false);
+        leaders[0] = true;
+        for (size_t i = 0; i < num_insns; ++i) {
+            const Instruction *inst = Instruction::At(insns + insns_[i].pc);
+            VisitBranchTargets(*inst, insns_[i].pc, insns_size, [&](int64_t target_pc) {
+                uint32_t target = insn_index(target_pc);
+                if (target != kNoInsn) {
+                    leaders[target] = true;
+                }
+            });
+            if (inst->IsThrow() && insn_try[i] != nullptr) {
+                leaders[i] = true;
+                leaders[i + 1u] = true;
+            } else if (inst->IsBasicBlockEnd() || inst->IsSwitch()) {
+                leaders[i + 1u] = true;
+            }
+        }
+        if (code_item->Tries() != nullptr) {
+            for (const auto &try_item : *code_item->Tries()) {
+                visit_handlers(try_item.get(), [&](uint32_t target) { leaders[target] = true; });
+            }
+        }
+        std::vector<uint32_t> block_of(num_insns);
+        for (size_t i = 0; i < num_insns; ++i) {
+            if (leaders[i] || i - block_starts_.back() >= kMaxBlockInsns) {
+                block_starts_.push_back(i);
+            }
+            block_of[i] = block_starts_.size() - 1u;
+        }
+
+        std::vector<uint32_t> succ_offsets(1u, 0u);
+        std::vector<uint32_t> succs;
+        for (size_t block = 0; block < block_starts_.size(); ++block) {
+            const size_t last = (block + 1u < block_starts_.size() ? block_starts_[block + 1u] : num_insns) - 1u;
+            const Instruction *inst = Instruction::At(insns + insns_[last].pc);
+            if (inst->CanFlowThrough() && last + 1u < num_insns) {
+                succs.push_back(block + 1u);
+            }
+            VisitBranchTargets(*inst, insns_[last].pc, insns_size, [&](int64_t target_pc) {
+                uint32_t target = insn_index(target_pc);
+                if (target != kNoInsn) {
+                    succs.push_back(block_of[target]);
+                }
+            });
+            if (inst->IsThrow()) {
+                visit_handlers(insn_try[last], [&](uint32_t target) {
+                    succs.push_back(block_of[target] | kExceptionalEdge);
+                });
+            }
+            succ_offsets.push_back(succs.size());
+        }
+
+        Solve(succ_offsets, succs);
+
+        def_values_.resize(defs_.size());
+        std::vector<uint8_t> states(defs_.size(), kUnresolved);
+        for (uint32_t def = registers_size_; def < defs_.size(); ++def) {
+            ResolveValue(code_item, def, &states, 0);
+        }
+    }
+
+    void RegisterDataflow::Solve(const std::vector<uint32_t> &succ_offsets, const std::vector<uint32_t> &succs) {
+        const size_t num_blocks = block_starts_.size();
+        set_words_ = (defs_.size() + 63u) / 64u;
+
+        // Transfer function of every block, out = gen | (in & ~kill). A definition is generated when
+        // no later instruction of the block writes one of its registers, and every definition of a
+        // register the block writes is killed.
+        std::vector<uint64_t> gen(num_blocks * set_words_, 0u);
+        std::vector<uint64_t> kill(num_blocks * set_words_, 0u);
+        std::vector<uint32_t> written_in(registers_size_, kNoInsn);
+        for (uint32_t block = 0; block < num_blocks; ++block) {
+            uint64_t *block_gen = &gen[block * set_words_];
+            uint64_t *block_kill = &kill[block * set_words_];
+            const size_t end = block + 1u < num_blocks ? block_starts_[block + 1u] : insns_.size();
+            for (size_t i = end; i > block_starts_[block]; --i) {
+                const uint32_t def = insns_[i - 1u].def;
+                if (def == kNoDef) {
+                    continue;
+                }
+                const uint32_t last_reg = defs_[def].reg + (defs_[def].wide ? 1u : 0u);
+                bool live = true;
+                for (uint32_t reg = defs_[def].reg; reg <= last_reg; ++reg) {
+                    if (written_in[reg] == block) {
+                        live = false;
+                        continue;
+                    }
+                    written_in[reg] = block;
+                    for (uint32_t k = reg_def_offsets_[reg]; k < reg_def_offsets_[reg + 1u]; ++k) {
+                        block_kill[reg_defs_[k] / 64u] |= uint64_t(1) << (reg_defs_[k] % 64u);
+                    }
+                }
+                if (live) {
+                    block_gen[def / 64u] |= uint64_t(1) << (def % 64u);
+                }
+            }
+        }
+
+        block_in_.assign(num_blocks * set_words_, 0u);
+        for (uint32_t reg = 0; reg < registers_size_; ++reg) {
+            block_in_[reg / 64u] |= uint64_t(1) << (reg % 64u);
+        }
+        std::vector<uint64_t> out(set_words_);
+        std::vector<bool> queued(num_blocks, false);
+        std::deque<uint32_t> work_list;
+        work_list.push_back(0u);
+        queued[0] = true;
+        while (!work_list.empty()) {
+            const uint32_t block = work_list.front();
+            work_list.pop_front();
+            queued[block] = false;
+
+            const uint64_t *in = &block_in_[block * set_words_];
+            const uint64_t *block_gen = &gen[block * set_words_];
+            const uint64_t *block_kill = &kill[block * set_words_];
+            for (size_t word = 0; word < set_words_; ++word) {
+                out[word] = block_gen[word] | (in[word] & ~block_kill[word]);
+            }
+            for (uint32_t k = succ_offsets[block]; k < succ_offsets[block + 1u]; ++k) {
+                const uint32_t succ = succs[k] & ~kExceptionalEdge;
+                const uint64_t *flow = (succs[k] & kExceptionalEdge) != 0 ? in : out.data();
+                uint64_t *succ_in = &block_in_[succ * set_words_];
+                bool changed = false;
+                for (size_t word = 0; word < set_words_; ++word) {
+                    const uint64_t merged = succ_in[word] | flow[word];
+                    changed |= merged != succ_in[word];
+                    succ_in[word] = merged;
+                }
+                if (changed && !queued[succ]) {
+                    work_list.push_back(succ);
+                    queued[succ] = true;
+                }
+            }
+        }
+    }
+
+    size_t RegisterDataflow::FindInsn(uint32_t pc) const {
+        return std::lower_bound(insns_.begin(), insns_.end(), pc,
+                                [](const Insn &insn, uint32_t value) { return insn.pc < value; }) - insns_.begin();
+    }
+
+    template<typename Visitor>
+    void RegisterDataflow::VisitReachingDefinitions(uint32_t reg, size_t insn_idx, Visitor &&visit) const {
+        if (reg >= registers_size_ || block_starts_.empty()) {
+            return;
+        }
+        const size_t block = std::upper_bound(block_starts_.begin(), block_starts_.end(), insn_idx) -
+                             block_starts_.begin() - 1u;
+        // A definition earlier in the same block hides all others.
+        for (size_t i = insn_idx; i > block_starts_[block]; --i) {
+            const uint32_t def = insns_[i - 1u].def;
+            if (def != kNoDef && (defs_[def].reg == reg || (defs_[def].wide && defs_[def].reg + 1u == reg))) {
+                visit(def);
+                return;
+            }
+        }
+        const uint64_t *in = &block_in_[block * set_words_];
+        for (uint32_t k = reg_def_offsets_[reg]; k < reg_def_offsets_[reg + 1u]; ++k) {
+            const uint32_t def = reg_defs_[k];
+            if ((in[def / 64u] >> (def % 64u)) & 1u) {
+                visit(def);
+            }
+        }
+    }
+
+    RegisterDataflow::Value RegisterDataflow::ResolveValue(const CodeItem *code_item, uint32_t def,
+                                                           std::vector<uint8_t> *states, int depth) {
+        if ((*states)[def] == kResolved) {
+            return def_values_[def];
+        }
+        if ((*states)[def] == kResolving || depth > kMaxMoveDepth) {
+            // A cycle of moves in a loop or a very long chain, stay conservative.
+            return Value();
+        }
+        Value value;
+        const Def &d = defs_[def];
+        if (d.pc != kEntryPc) {
+            const Instruction *inst = Instruction::At(code_item->Insns() + d.pc);
+            switch (inst->Opcode()) {
+                case Instruction::CONST_4:
+                    value = {kConstant, inst->VRegB_11n()};
+                    break;
+                case Instruction::CONST_16:
+                case Instruction::CONST_WIDE_16:
+                    value = {kConstant, inst->VRegB_21s()};
+                    break;
+                case Instruction::CONST:
+                case Instruction::CONST_WIDE_32:
+                    value = {kConstant, inst->VRegB_31i()};
+                    break;
+                case Instruction::CONST_HIGH16:
+                    value = {kConstant, static_cast<int32_t>(static_cast<uint32_t>(inst->VRegB_21h()) << 16)};
+                    break;
+                case Instruction::CONST_WIDE_HIGH16:
+                    value = {kConstant, static_cast<int64_t>(static_cast<uint64_t>(inst->VRegB_21h()) << 48)};
+                    break;
+                case Instruction::CONST_WIDE:
+                    value = {kConstant, static_cast<int64_t>(inst->WideVRegB())};
+                    break;
+                case Instruction::CONST_STRING:
+                    value = {kString, inst->VRegB_21c()};
+                    break;
+                case Instruction::CONST_STRING_JUMBO:
+                    value = {kString, inst->VRegB_31c()};
+                    break;
+                case Instruction::MOVE:
+                case Instruction::MOVE_FROM16:
+                case Instruction::MOVE_16:
+                case Instruction::MOVE_WIDE:
+                case Instruction::MOVE_WIDE_FROM16:
+                case Instruction::MOVE_WIDE_16:
+                case Instruction::MOVE_OBJECT:
+                case Instruction::MOVE_OBJECT_FROM16:
+                case Instruction::MOVE_OBJECT_16: {
+                    (*states)[def] = kResolving;
+                    const uint32_t src = inst->VRegB();
+                    bool first = true;
+                    VisitReachingDefinitions(src, FindInsn(d.pc), [&](uint32_t src_def) {
+                        Value src_value = ResolveValue(code_item, src_def, states, depth + 1);
+                        if (defs_[src_def].reg != src) {
+                            src_value = Value();
+                        }
+                        if (first) {
+                            value = src_value;
+                            first = false;
+                        } else if (src_value != value) {
+                            value = Value();
+                        }
+                    });
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        (*states)[def] = kResolved;
+        def_values_[def] = value;
+        return value;
+    }
+
+    RegisterDataflow::Value RegisterDataflow::GetDefValue(uint32_t reg, uint32_t def) const {
+        // The upper half of a wide value has no value of its own.
+        return defs_[def].reg == reg ? def_values_[def] : Value();
+    }
+
+    std::vector<uint32_t> RegisterDataflow::GetReachingDefinitions(uint32_t reg, uint32_t pc) const {
+        std::vector<uint32_t> pcs;
+        VisitReachingDefinitions(reg, FindInsn(pc), [&](uint32_t def) { pcs.push_back(defs_[def].pc); });
+        std::sort(pcs.begin(), pcs.end());
+        return pcs;
+    }
+
+    RegisterDataflow::Value RegisterDataflow::GetValue(uint32_t reg, uint32_t pc) const {
+        Value value;
+        bool first = true;
+        VisitReachingDefinitions(reg, FindInsn(pc), [&](uint32_t def) {
+            const Value def_value = GetDefValue(reg, def);
+            if (first) {
+                value = def_value;
+                first = false;
+            } else if (def_value != value) {
+                value = Value();
+            }
+        });
+        return value;
+    }
+
+    RegisterDataflow::Value RegisterDataflow::GetLastValue(uint32_t reg) const {
+        if (reg >= registers_size_) {
+            return Value();
+        }
+        // The entry definition comes first, the list holds only it when |reg| is never written.
+        const uint32_t def = reg_defs_[reg_def_offsets_[reg + 1u] - 1u];
+        return GetDefValue(reg, def);
+    }
+}
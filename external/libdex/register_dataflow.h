@@ -0,0 +1,106 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_REGISTER_DATAFLOW_H
+#define BASE_REGISTER_DATAFLOW_H
+
+#include <stdint.h>
+#include <vector>
+#include <libbase/macros.h>
+
+namespace dex_ir {
+    class CodeItem;
+
+    // Reaching definitions of the registers of one method, solved once over the basic blocks of its
+    // code. Blocks start at the branch, switch and handler targets VeriFlowAnalysis::FindBranches
+    // marks. An instruction that may throw inside a try range gets a block of its own, so that the
+    // handlers see the registers as they were before it, and long runs of code are cut. Only the
+    // definitions reaching the start of every block are kept, a query replays the block up to its pc.
+    //
+    // The value of every const and const-string definition is propagated through the moves that copy
+    // it, a register is known at a pc when all definitions reaching it agree.
+    class RegisterDataflow {
+    public:
+        // Pc of the definition standing for the value a register holds when the method is entered.
+        static constexpr uint32_t kEntryPc = 0xffffffffu;
+
+        enum ValueKind : uint8_t {
+            kUnknown,
+            kConstant,  // The literal, sign extended.
+            kString,    // A string index.
+        };
+
+        struct Value {
+            ValueKind kind = kUnknown;
+            int64_t value = 0;
+
+            bool operator==(const Value &other) const { return kind == other.kind && value == other.value; }
+
+            bool operator!=(const Value &other) const { return !(*this == other); }
+        };
+
+        explicit RegisterDataflow(const CodeItem *code_item);
+
+        // Pcs of the definitions of |reg| that may reach the instruction at |pc| or, when |pc| is not
+        // the start of an instruction, the first one after it. Sorted, so kEntryPc comes last. Empty
+        // when the instruction is unreachable.
+        std::vector<uint32_t> GetReachingDefinitions(uint32_t reg, uint32_t pc) const;
+
+        // Value of |reg| read by the instruction at |pc|, same lookup as above.
+        Value GetValue(uint32_t reg, uint32_t pc) const;
+
+        // Value written to |reg| by its last definition in code order, regardless of control flow.
+        Value GetLastValue(uint32_t reg) const;
+
+        size_t NumBlocks() const { return block_starts_.size(); }
+
+        // Definitions made by instructions, not counting the entry definitions.
+        size_t NumDefinitions() const { return defs_.size() - registers_size_; }
+
+    private:
+        static constexpr uint32_t kNoDef = 0xffffffffu;
+
+        struct Insn {
+            uint32_t pc;
+            uint32_t def;  // Index in defs_, kNoDef for instructions that write no register.
+        };
+
+        struct Def {
+            uint32_t pc;
+            uint16_t reg;
+            bool wide;  // Also writes reg + 1.
+        };
+
+        void Solve(const std::vector<uint32_t> &succ_offsets, const std::vector<uint32_t> &succs);
+
+        // Index of the first instruction at or after |pc|.
+        size_t FindInsn(uint32_t pc) const;
+
+        // Calls visit(def) for every definition of |reg| reaching instruction |insn_idx|.
+        template<typename Visitor>
+        void VisitReachingDefinitions(uint32_t reg, size_t insn_idx, Visitor &&visit) const;
+
+        Value ResolveValue(const CodeItem *code_item, uint32_t def, std::vector<uint8_t> *states, int depth);
+
+        Value GetDefValue(uint32_t reg, uint32_t def) const;
+
+        uint32_t registers_size_ = 0;
+        std::vector<Insn> insns_;
+        // Entry definitions first, one per register, then in pc order.
+        std::vector<Def> defs_;
+        std::vector<Value> def_values_;
+        // Definitions of every register, wide ones listed for both registers.
+        std::vector<uint32_t> reg_def_offsets_;
+        std::vector<uint32_t> reg_defs_;
+        // Index in insns_ of the first instruction of every block.
+        std::vector<uint32_t> block_starts_;
+        // Bit sets over defs_ of the definitions reaching the start of every block.
+        std::vector<uint64_t> block_in_;
+        size_t set_words_ = 0;
+
+        DISALLOW_COPY_AND_ASSIGN(RegisterDataflow);
+    };
+}
+
+#endif //BASE_REGISTER_DATAFLOW_H
@@ -6,15 +6,23 @@
 #include <string.h>
 namespace dex_ir {
 
-    StringData::StringData(const char *data) : data_(strdup(data)) {
+    StringData::StringData(const char *data) : StringData(data, true) {}
+
+    StringData::StringData(const char *data, bool copy) {
+        if (copy) {
+            owned_data_.reset(strdup(data));
+            data_ = owned_data_.get();
+        } else {
+            data_ = data;
+        }
         size_ = base::UnsignedLeb128Size(libdex::CountModifiedUtf8Chars(data)) + strlen(data);
     }
 
-    const char *StringData::Data() const { return data_.get(); }
+    const char *StringData::Data() const { return data_; }
 
     bool StringData::SetData(const char *data) {
-        data_.reset(nullptr);
-        data_ = base::UniqueCPtr<const char>(strdup(data));
+        owned_data_ = base::UniqueCPtr<const char>(strdup(data));
+        data_ = owned_data_.get();
         return true;
     }
 }
\ No newline at end of file
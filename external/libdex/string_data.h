@@ -15,10 +15,15 @@ namespace dex_ir {
     public:
         explicit StringData(const char *data);
 
+        // With copy == false the item only points at |data|, which must outlive it. SetData always
+        // makes a private copy.
+        StringData(const char *data, bool copy);
+
         const char *Data() const;
         bool SetData(const char *data);
     private:
-        base::UniqueCPtr<const char> data_;
+        const char *data_;
+        base::UniqueCPtr<const char> owned_data_;
         DISALLOW_COPY_AND_ASSIGN(StringData);
     };
 }
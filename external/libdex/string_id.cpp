@@ -21,10 +21,14 @@ namespace dex_ir {
     StringData *StringId::DataItem() const { return string_data_; }
 
     void StringId::AddMethodRefs(uint32_t id) {
-        this->method_ref_idx.insert(id);
+        this->method_ref_idx.Insert(id);
     }
 
-    std::set<uint32_t> StringId::GetMethodRefs() const {
+    void StringId::SetMethodRefs(base::ArrayRef<const uint32_t> ids) {
+        this->method_ref_idx.SetView(ids);
+    }
+
+    const RefSet &StringId::GetMethodRefs() const {
         return this->method_ref_idx;
     }
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "indexed_item.h"
 #include "string_data.h"
 #include "dexir_util.h"
+#include "ref_set.h"
 
 namespace dex_ir {
     class StringId : public IndexedItem {
@@ -23,13 +24,15 @@ namespace dex_ir {
         StringData *DataItem() const;
 
 
-        std::set<uint32_t> GetMethodRefs() const;
+        const RefSet &GetMethodRefs() const;
 
         void AddMethodRefs(uint32_t id);
 
+        void SetMethodRefs(base::ArrayRef<const uint32_t> ids);
+
     private:
         StringData *string_data_;
-        std::set<uint32_t> method_ref_idx;
+        RefSet method_ref_idx;
         DISALLOW_COPY_AND_ASSIGN(StringId);
     };
 }
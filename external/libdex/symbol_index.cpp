@@ -0,0 +1,542 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <string.h>
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+#include "symbol_index.h"
+#include "header.h"
+
+namespace dex_ir {
+
+    namespace {
+        constexpr size_t kTrigramSize = 3;
+
+        uint64_t Hash(const char *data) {
+            return std::hash<std::string_view>()(std::string_view(data));
+        }
+
+        uint64_t Hash(const char *class_name, const char *name, const char *signature) {
+            uint64_t hash = Hash(class_name);
+            hash = (hash ^ Hash(name)) * 0x9e3779b97f4a7c15ull;
+            return (hash ^ Hash(signature)) * 0x9e3779b97f4a7c15ull;
+        }
+
+        uint32_t Trigram(const char *data) {
+            return (static_cast<uint32_t>(static_cast<uint8_t>(data[0])) << 16) |
+                   (static_cast<uint32_t>(static_cast<uint8_t>(data[1])) << 8) |
+                   static_cast<uint32_t>(static_cast<uint8_t>(data[2]));
+        }
+
+        void Trigrams(const char *data, size_t length, std::vector<uint32_t> *trigrams) {
+            trigrams->clear();
+            for (size_t i = 0; i + kTrigramSize <= length; ++i) {
+                trigrams->push_back(Trigram(data + i));
+            }
+            std::sort(trigrams->begin(), trigrams->end());
+            trigrams->erase(std::unique(trigrams->begin(), trigrams->end()), trigrams->end());
+        }
+
+        bool IsSyntaxChar(char c) {
+            return strchr("^$\\.*+?()[]{}|/-", c) != nullptr;
+        }
+
+        // Returns the index just past the escape sequence that starts at |pos|.
+        size_t SkipEscape(const std::string &pattern, size_t pos) {
+            size_t end = pos + 2;
+            char c = pattern[pos + 1];
+            if (c == 'x') {
+                end += 2;
+            } else if (c == 'u') {
+                end += 4;
+            } else if (c == 'c') {
+                end += 1;
+            } else if (c >= '0' && c <= '9') {
+                while (end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9') {
+                    ++end;
+                }
+            }
+            return std::min(end, pattern.size());
+        }
+
+        // Returns the index just past the group or class that starts at |pos|.
+        size_t SkipGroup(const std::string &pattern, size_t pos) {
+            int depth = 0;
+            bool in_class = false;
+            for (size_t i = pos; i < pattern.size(); ++i) {
+                char c = pattern[i];
+                if (c == '\\') {
+                    ++i;
+                } else if (in_class) {
+                    in_class = c != ']';
+                } else if (c == '[') {
+                    in_class = true;
+                } else if (c == '(') {
+                    ++depth;
+                } else if (c == ')' && --depth == 0) {
+                    return i + 1;
+                }
+                if (!in_class && depth == 0 && pattern[pos] == '[') {
+                    return i + 1;
+                }
+            }
+            return pattern.size();
+        }
+    }
+
+    RegexFilter::RegexFilter(const std::string &pattern) : regex_(pattern) {
+        std::string run;
+        bool run_is_prefix = true;
+        auto end_run = [&]() {
+            if (!run.empty()) {
+                if (run_is_prefix) {
+                    prefix_ = run;
+                }
+                literals_.push_back(run);
+                run.clear();
+            }
+            run_is_prefix = false;
+        };
+        size_t i = 0;
+        if (!pattern.empty() && pattern[0] == '^') {
+            ++i;
+        }
+        while (i < pattern.size()) {
+            char c = pattern[i];
+            bool literal = false;
+            char literal_char = 0;
+            if (c == '|') {
+                // A top level alternation, no literal is required.
+                prefix_.clear();
+                literals_.clear();
+                return;
+            } else if (c == '\\' && i + 1 < pattern.size()) {
+                // Only an escaped syntax character stands for itself, \xHH, \uHHHH, \cX, classes and
+                // back references are skipped as a whole.
+                literal = IsSyntaxChar(pattern[i + 1]);
+                literal_char = pattern[i + 1];
+                i = SkipEscape(pattern, i);
+            } else if (c == '[' || c == '(') {
+                // Groups and classes are skipped as a whole, alternations inside them are fine.
+                i = SkipGroup(pattern, i);
+            } else if (c == '.' || c == '^' || c == '$' || c == '\\') {
+                ++i;
+            } else {
+                literal = true;
+                literal_char = c;
+                ++i;
+            }
+            // The quantifier, if any, applies to the atom just read.
+            bool optional = false;
+            bool repeated = false;
+            if (i < pattern.size()) {
+                char q = pattern[i];
+                if (q == '*' || q == '?') {
+                    optional = true;
+                    ++i;
+                } else if (q == '+') {
+                    repeated = true;
+                    ++i;
+                } else if (q == '{') {
+                    size_t close = pattern.find('}', i);
+                    if (close != std::string::npos) {
+                        optional = atoi(pattern.c_str() + i + 1) == 0;
+                        repeated = !optional;
+                        i = close + 1;
+                    }
+                }
+                if ((optional || repeated) && i < pattern.size() && pattern[i] == '?') {
+                    ++i;  // Lazy quantifier.
+                }
+            }
+            if (!literal || optional) {
+                end_run();
+            } else {
+                run += literal_char;
+                if (repeated) {
+                    end_run();
+                }
+            }
+        }
+        end_run();
+    }
+
+    const std::string &RegexFilter::LongestLiteral() const {
+        static const std::string kEmpty;
+        const std::string *longest = &kEmpty;
+        for (const std::string &literal : literals_) {
+            if (literal.size() > longest->size()) {
+                longest = &literal;
+            }
+        }
+        return *longest;
+    }
+
+    bool RegexFilter::Matches(const char *data) const {
+        if (!prefix_.empty() && strncmp(data, prefix_.data(), prefix_.size()) != 0) {
+            return false;
+        }
+        for (const std::string &literal : literals_) {
+            if (strstr(data, literal.c_str()) == nullptr) {
+                return false;
+            }
+        }
+        return std::regex_match(data, regex_);
+    }
+
+    SymbolIndex::SymbolIndex(const Header *header) : header_(header) {
+        const uint32_t num_strings = header->StringIds().Size();
+        string_hashes_.reserve(num_strings);
+        std::vector<uint64_t> trigram_pairs;
+        std::vector<uint32_t> trigrams;
+        for (uint32_t i = 0; i < num_strings; ++i) {
+            const char *data = StringData(i);
+            string_hashes_.push_back({Hash(data), i});
+            Trigrams(data, strlen(data), &trigrams);
+            for (uint32_t trigram : trigrams) {
+                trigram_pairs.push_back((static_cast<uint64_t>(trigram) << 32) | i);
+            }
+        }
+        std::sort(string_hashes_.begin(), string_hashes_.end());
+        // Sorting the pairs groups them by trigram with ascending string indices in each group.
+        std::sort(trigram_pairs.begin(), trigram_pairs.end());
+        trigram_strings_.reserve(trigram_pairs.size());
+        for (uint64_t pair : trigram_pairs) {
+            uint32_t trigram = static_cast<uint32_t>(pair >> 32);
+            if (trigrams_.empty() || trigrams_.back() != trigram) {
+                trigrams_.push_back(trigram);
+                trigram_offsets_.push_back(trigram_strings_.size());
+            }
+            trigram_strings_.push_back(static_cast<uint32_t>(pair));
+        }
+        trigram_offsets_.push_back(trigram_strings_.size());
+        std::vector<uint64_t>().swap(trigram_pairs);
+
+        sorted_strings_.resize(num_strings);
+        std::iota(sorted_strings_.begin(), sorted_strings_.end(), 0u);
+        std::sort(sorted_strings_.begin(), sorted_strings_.end(), [this](uint32_t a, uint32_t b) {
+            return strcmp(StringData(a), StringData(b)) < 0;
+        });
+
+        string_types_.assign(num_strings, -1);
+        for (uint32_t i = 0; i < header->TypeIds().Size(); ++i) {
+            int32_t &type = string_types_[header->TypeIds()[i]->GetStringId()->GetIndex()];
+            if (type < 0) {
+                type = static_cast<int32_t>(i);
+            }
+        }
+
+        proto_signatures_.reserve(header->ProtoIds().Size());
+        for (const auto &proto_id : header->ProtoIds()) {
+            proto_signatures_.push_back(proto_id->GetSignatureForProtoId());
+        }
+        method_hashes_.reserve(header->MethodIds().Size());
+        for (const auto &method_id : header->MethodIds()) {
+            method_hashes_.push_back({Hash(method_id->Class()->GetStringId()->Data(),
+                                           method_id->Name()->Data(),
+                                           proto_signatures_[method_id->Proto()->GetIndex()].c_str()),
+                                      method_id->GetIndex()});
+        }
+        std::sort(method_hashes_.begin(), method_hashes_.end());
+        field_hashes_.reserve(header->FieldIds().Size());
+        for (const auto &field_id : header->FieldIds()) {
+            field_hashes_.push_back({Hash(field_id->Class()->GetStringId()->Data(),
+                                          field_id->Name()->Data(),
+                                          field_id->Type()->GetStringId()->Data()),
+                                     field_id->GetIndex()});
+        }
+        std::sort(field_hashes_.begin(), field_hashes_.end());
+    }
+
+    SymbolIndex::~SymbolIndex() {
+    }
+
+    const char *SymbolIndex::StringData(uint32_t string_idx) const {
+        const char *data = header_->StringIds()[string_idx]->Data();
+        return data != nullptr ? data : "";
+    }
+
+    template<class Predicate>
+    int64_t SymbolIndex::FindHash(const std::vector<HashEntry> &entries, uint64_t hash, Predicate predicate) const {
+        for (auto it = std::lower_bound(entries.begin(), entries.end(), HashEntry{hash, 0u});
+             it != entries.end() && it->hash == hash; ++it) {
+            if (predicate(it->index)) {
+                return it->index;
+            }
+        }
+        return -1;
+    }
+
+    int64_t SymbolIndex::FindString(const std::string &value) const {
+        return FindHash(string_hashes_, Hash(value.c_str()), [&](uint32_t idx) {
+            return value.compare(StringData(idx)) == 0;
+        });
+    }
+
+    int64_t SymbolIndex::FindType(const std::string &descriptor) const {
+        int64_t string_idx = FindString(descriptor);
+        return string_idx < 0 ? -1 : string_types_[string_idx];
+    }
+
+    int64_t SymbolIndex::FindMethod(const MemberSignature &signature) const {
+        uint64_t hash = Hash(signature.class_name.c_str(), signature.name.c_str(), signature.signature.c_str());
+        return FindHash(method_hashes_, hash, [&](uint32_t idx) {
+            const MethodId *method_id = header_->MethodIds()[idx];
+            return signature.class_name.compare(method_id->Class()->GetStringId()->Data()) == 0 &&
+                   signature.name.compare(method_id->Name()->Data()) == 0 &&
+                   signature.signature == proto_signatures_[method_id->Proto()->GetIndex()];
+        });
+    }
+
+    int64_t SymbolIndex::FindField(const MemberSignature &signature) const {
+        uint64_t hash = Hash(signature.class_name.c_str(), signature.name.c_str(), signature.signature.c_str());
+        return FindHash(field_hashes_, hash, [&](uint32_t idx) {
+            const FieldId *field_id = header_->FieldIds()[idx];
+            return signature.class_name.compare(field_id->Class()->GetStringId()->Data()) == 0 &&
+                   signature.name.compare(field_id->Name()->Data()) == 0 &&
+                   signature.signature.compare(field_id->Type()->GetStringId()->Data()) == 0;
+        });
+    }
+
+    bool SymbolIndex::NarrowByLiteral(const std::string &literal, std::vector<uint32_t> *candidates) const {
+        if (literal.size() < kTrigramSize) {
+            return false;
+        }
+        std::vector<uint32_t> trigrams;
+        Trigrams(literal.data(), literal.size(), &trigrams);
+        // Intersect the posting lists, shortest first.
+        std::vector<std::pair<uint32_t, uint32_t>> postings;
+        for (uint32_t trigram : trigrams) {
+            auto it = std::lower_bound(trigrams_.begin(), trigrams_.end(), trigram);
+            if (it == trigrams_.end() || *it != trigram) {
+                candidates->clear();
+                return true;
+            }
+            size_t row = it - trigrams_.begin();
+            postings.emplace_back(trigram_offsets_[row], trigram_offsets_[row + 1]);
+        }
+        std::sort(postings.begin(), postings.end(), [](const auto &a, const auto &b) {
+            return a.second - a.first < b.second - b.first;
+        });
+        candidates->assign(trigram_strings_.begin() + postings[0].first,
+                           trigram_strings_.begin() + postings[0].second);
+        std::vector<uint32_t> intersection;
+        for (size_t i = 1; i < postings.size() && !candidates->empty(); ++i) {
+            intersection.clear();
+            std::set_intersection(candidates->begin(), candidates->end(),
+                                  trigram_strings_.begin() + postings[i].first,
+                                  trigram_strings_.begin() + postings[i].second,
+                                  std::back_inserter(intersection));
+            candidates->swap(intersection);
+        }
+        return true;
+    }
+
+    bool SymbolIndex::NarrowByFilter(const RegexFilter &filter, std::vector<uint32_t> *candidates) const {
+        if (!filter.Prefix().empty()) {
+            *candidates = FindStringsWithPrefix(filter.Prefix());
+            return true;
+        }
+        return NarrowByLiteral(filter.LongestLiteral(), candidates);
+    }
+
+    std::vector<uint32_t> SymbolIndex::FindStringsContaining(const std::string &value, bool first_only) const {
+        std::vector<uint32_t> result;
+        std::vector<uint32_t> candidates;
+        if (NarrowByLiteral(value, &candidates)) {
+            for (uint32_t idx : candidates) {
+                if (strstr(StringData(idx), value.c_str()) != nullptr) {
+                    result.push_back(idx);
+                    if (first_only) {
+                        break;
+                    }
+                }
+            }
+            return result;
+        }
+        for (uint32_t idx = 0; idx < header_->StringIds().Size(); ++idx) {
+            if (strstr(StringData(idx), value.c_str()) != nullptr) {
+                result.push_back(idx);
+                if (first_only) {
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+
+    std::vector<uint32_t> SymbolIndex::FindStringsWithPrefix(const std::string &prefix) const {
+        auto it = std::lower_bound(sorted_strings_.begin(), sorted_strings_.end(), prefix,
+                                   [this](uint32_t idx, const std::string &value) {
+                                       return strcmp(StringData(idx), value.c_str()) < 0;
+                                   });
+        std::vector<uint32_t> result;
+        for (; it != sorted_strings_.end() && strncmp(StringData(*it), prefix.data(), prefix.size()) == 0; ++it) {
+            result.push_back(*it);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    std::vector<uint32_t> SymbolIndex::MatchStrings(const RegexFilter &filter) const {
+        std::vector<uint32_t> result;
+        std::vector<uint32_t> candidates;
+        if (NarrowByFilter(filter, &candidates)) {
+            for (uint32_t idx : candidates) {
+                const char *data = StringData(idx);
+                if (data[0] != '\0' && filter.Matches(data)) {
+                    result.push_back(idx);
+                }
+            }
+            return result;
+        }
+        for (uint32_t idx = 0; idx < header_->StringIds().Size(); ++idx) {
+            const char *data = StringData(idx);
+            if (data[0] != '\0' && filter.Matches(data)) {
+                result.push_back(idx);
+            }
+        }
+        return result;
+    }
+
+    std::vector<uint32_t> SymbolIndex::MatchTypes(const RegexFilter &filter) const {
+        std::vector<uint32_t> result;
+        std::vector<uint32_t> candidates;
+        if (NarrowByFilter(filter, &candidates)) {
+            for (uint32_t idx : candidates) {
+                const char *data = StringData(idx);
+                if (string_types_[idx] >= 0 && data[0] != '\0' && filter.Matches(data)) {
+                    result.push_back(string_types_[idx]);
+                }
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+        for (const auto &type_id : header_->TypeIds()) {
+            const char *data = type_id->GetStringId()->Data();
+            if (data[0] != '\0' && filter.Matches(data)) {
+                result.push_back(type_id->GetIndex());
+            }
+        }
+        return result;
+    }
+
+    namespace {
+        // Remembers the outcome of a filter per distinct string, type or proto.
+        class MatchCache {
+        public:
+            explicit MatchCache(size_t size) : states_(size, kUnknown) {}
+
+            template<class Data>
+            bool Matches(uint32_t idx, const RegexFilter &filter, Data data) {
+                if (states_[idx] == kUnknown) {
+                    states_[idx] = filter.Matches(data()) ? kMatch : kNoMatch;
+                }
+                return states_[idx] == kMatch;
+            }
+
+        private:
+            static constexpr uint8_t kUnknown = 0;
+            static constexpr uint8_t kMatch = 1;
+            static constexpr uint8_t kNoMatch = 2;
+            std::vector<uint8_t> states_;
+        };
+    }
+
+    std::vector<uint32_t> SymbolIndex::MatchMethods(const RegexFilter &class_filter,
+                                                    const RegexFilter &name_filter,
+                                                    const RegexFilter &signature_filter) const {
+        MatchCache classes(header_->TypeIds().Size());
+        MatchCache names(header_->StringIds().Size());
+        MatchCache protos(header_->ProtoIds().Size());
+        std::vector<uint32_t> result;
+        for (const auto &method_id : header_->MethodIds()) {
+            const TypeId *type_id = method_id->Class();
+            const StringId *name = method_id->Name();
+            uint32_t proto_idx = method_id->Proto()->GetIndex();
+            if (classes.Matches(type_id->GetIndex(), class_filter, [&] { return type_id->GetStringId()->Data(); }) &&
+                names.Matches(name->GetIndex(), name_filter, [&] { return name->Data(); }) &&
+                protos.Matches(proto_idx, signature_filter, [&] { return proto_signatures_[proto_idx].c_str(); })) {
+                result.push_back(method_id->GetIndex());
+            }
+        }
+        return result;
+    }
+
+    std::vector<uint32_t> SymbolIndex::MatchFields(const RegexFilter &class_filter,
+                                                   const RegexFilter &name_filter,
+                                                   const RegexFilter &type_filter) const {
+        MatchCache classes(header_->TypeIds().Size());
+        MatchCache names(header_->StringIds().Size());
+        MatchCache types(header_->TypeIds().Size());
+        std::vector<uint32_t> result;
+        for (const auto &field_id : header_->FieldIds()) {
+            const TypeId *class_id = field_id->Class();
+            const StringId *name = field_id->Name();
+            const TypeId *type_id = field_id->Type();
+            if (classes.Matches(class_id->GetIndex(), class_filter, [&] { return class_id->GetStringId()->Data(); }) &&
+                names.Matches(name->GetIndex(), name_filter, [&] { return name->Data(); }) &&
+                types.Matches(type_id->GetIndex(), type_filter, [&] { return type_id->GetStringId()->Data(); })) {
+                result.push_back(field_id->GetIndex());
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::vector<uint32_t>> SymbolIndex::FindStringsContaining(const std::vector<std::string> &values) const {
+        std::vector<std::vector<uint32_t>> results(values.size());
+        std::vector<size_t> scanned;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i].size() >= kTrigramSize) {
+                results[i] = FindStringsContaining(values[i], /*first_only=*/ false);
+            } else {
+                scanned.push_back(i);
+            }
+        }
+        if (!scanned.empty()) {
+            for (uint32_t idx = 0; idx < header_->StringIds().Size(); ++idx) {
+                const char *data = StringData(idx);
+                for (size_t i : scanned) {
+                    if (strstr(data, values[i].c_str()) != nullptr) {
+                        results[i].push_back(idx);
+                    }
+                }
+            }
+        }
+        return results;
+    }
+
+    std::vector<std::vector<uint32_t>> SymbolIndex::MatchStrings(const std::vector<const RegexFilter *> &filters) const {
+        std::vector<std::vector<uint32_t>> results(filters.size());
+        std::vector<size_t> scanned;
+        std::vector<uint32_t> candidates;
+        for (size_t i = 0; i < filters.size(); ++i) {
+            if (NarrowByFilter(*filters[i], &candidates)) {
+                for (uint32_t idx : candidates) {
+                    const char *data = StringData(idx);
+                    if (data[0] != '\0' && filters[i]->Matches(data)) {
+                        results[i].push_back(idx);
+                    }
+                }
+            } else {
+                scanned.push_back(i);
+            }
+        }
+        if (!scanned.empty()) {
+            for (uint32_t idx = 0; idx < header_->StringIds().Size(); ++idx) {
+                const char *data = StringData(idx);
+                if (data[0] == '\0') {
+                    continue;
+                }
+                for (size_t i : scanned) {
+                    if (filters[i]->Matches(data)) {
+                        results[i].push_back(idx);
+                    }
+                }
+            }
+        }
+        return results;
+    }
+}
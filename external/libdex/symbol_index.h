@@ -0,0 +1,132 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_SYMBOL_INDEX_H
+#define BASE_SYMBOL_INDEX_H
+
+#include <stdint.h>
+#include <regex>
+#include <string>
+#include <vector>
+#include <libbase/macros.h>
+
+namespace dex_ir {
+    class Header;
+
+    // A class, member name and signature triple, e.g. {"Ljava/lang/System;", "exit", "(I)V"} for a
+    // method or {"Landroid/os/Build;", "MODEL", "Ljava/lang/String;"} for a field.
+    struct MemberSignature {
+        std::string class_name;
+        std::string name;
+        std::string signature;
+    };
+
+    // A std::regex together with literals that every full match must contain, used to reject most
+    // candidates before running the regex. Only literals outside groups are extracted and patterns
+    // with a top level alternation get none, so the filter never rejects a match.
+    class RegexFilter {
+    public:
+        explicit RegexFilter(const std::string &pattern);
+
+        bool Matches(const char *data) const;
+
+        // Literal the data has to start with, may be empty.
+        const std::string &Prefix() const { return prefix_; }
+
+        // Longest literal the data has to contain, may be empty.
+        const std::string &LongestLiteral() const;
+
+    private:
+        std::regex regex_;
+        std::string prefix_;
+        std::vector<std::string> literals_;
+    };
+
+    // Lookup structures over the ids of a Header, built once by Decompilation::loadSymbolIndex:
+    //  - hashes of string data, type descriptors and method and field triples for exact lookups,
+    //  - the string ids sorted by data for prefix lookups,
+    //  - a trigram index over string data for substring lookups.
+    // Results are the same as a scan over the ids in index order. The index refers to ids by index
+    // and reads their data at query time; it has to be rebuilt after ids are renamed.
+    class SymbolIndex {
+    public:
+        explicit SymbolIndex(const Header *header);
+
+        ~SymbolIndex();
+
+        // Index of the first string id whose data is |value|, or -1.
+        int64_t FindString(const std::string &value) const;
+
+        int64_t FindType(const std::string &descriptor) const;
+
+        int64_t FindMethod(const MemberSignature &signature) const;
+
+        int64_t FindField(const MemberSignature &signature) const;
+
+        // Ascending indices of the string ids containing |value|, at most one when |first_only|.
+        std::vector<uint32_t> FindStringsContaining(const std::string &value, bool first_only) const;
+
+        // Ascending indices of the string ids starting with |prefix|.
+        std::vector<uint32_t> FindStringsWithPrefix(const std::string &prefix) const;
+
+        // Ascending indices of the non empty string ids fully matching |filter|.
+        std::vector<uint32_t> MatchStrings(const RegexFilter &filter) const;
+
+        std::vector<uint32_t> MatchTypes(const RegexFilter &filter) const;
+
+        std::vector<uint32_t> MatchMethods(const RegexFilter &class_filter,
+                                           const RegexFilter &name_filter,
+                                           const RegexFilter &signature_filter) const;
+
+        std::vector<uint32_t> MatchFields(const RegexFilter &class_filter,
+                                          const RegexFilter &name_filter,
+                                          const RegexFilter &type_filter) const;
+
+        // Batch forms: answer every query with one shared pass over the strings for the queries the
+        // index cannot narrow down.
+        std::vector<std::vector<uint32_t>> FindStringsContaining(const std::vector<std::string> &values) const;
+
+        std::vector<std::vector<uint32_t>> MatchStrings(const std::vector<const RegexFilter *> &filters) const;
+
+        // GetSignatureForProtoId() of every proto id, computed once.
+        const std::string &GetProtoSignature(uint32_t proto_idx) const { return proto_signatures_[proto_idx]; }
+
+    private:
+        struct HashEntry {
+            uint64_t hash;
+            uint32_t index;
+
+            bool operator<(const HashEntry &other) const {
+                return hash < other.hash || (hash == other.hash && index < other.index);
+            }
+        };
+
+        const char *StringData(uint32_t string_idx) const;
+
+        // Candidate strings for a filter or a substring, false if every string is a candidate.
+        bool NarrowByLiteral(const std::string &literal, std::vector<uint32_t> *candidates) const;
+
+        bool NarrowByFilter(const RegexFilter &filter, std::vector<uint32_t> *candidates) const;
+
+        template<class Predicate>
+        int64_t FindHash(const std::vector<HashEntry> &entries, uint64_t hash, Predicate predicate) const;
+
+        const Header *header_;
+        std::vector<HashEntry> string_hashes_;
+        std::vector<HashEntry> method_hashes_;
+        std::vector<HashEntry> field_hashes_;
+        // Type index of every string used as a type descriptor, -1 for the others.
+        std::vector<int32_t> string_types_;
+        std::vector<uint32_t> sorted_strings_;
+        // Trigram postings as compressed sparse rows over the sorted distinct trigrams.
+        std::vector<uint32_t> trigrams_;
+        std::vector<uint32_t> trigram_offsets_;
+        std::vector<uint32_t> trigram_strings_;
+        std::vector<std::string> proto_signatures_;
+
+        DISALLOW_COPY_AND_ASSIGN(SymbolIndex);
+    };
+}
+
+#endif //BASE_SYMBOL_INDEX_H
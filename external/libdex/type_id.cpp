@@ -16,10 +16,14 @@ namespace dex_ir {
     }
 
     void TypeId::AddMethodRef(uint32_t id) {
-        this->method_ref_idx.insert(id);
+        this->method_ref_idx.Insert(id);
     }
 
-    std::set<uint32_t> TypeId::GetMethodRefs() const {
+    void TypeId::SetMethodRefs(base::ArrayRef<const uint32_t> ids) {
+        this->method_ref_idx.SetView(ids);
+    }
+
+    const RefSet &TypeId::GetMethodRefs() const {
         return this->method_ref_idx;
     }
 
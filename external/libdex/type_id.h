@@ -9,6 +9,7 @@
 #include "indexed_item.h"
 #include "dexir_util.h"
 #include "string_id.h"
+#include "ref_set.h"
 
 namespace dex_ir {
     class TypeId : public IndexedItem {
@@ -25,12 +26,14 @@ namespace dex_ir {
 
         void AddMethodRef(uint32_t id);
 
-        std::set<uint32_t> GetMethodRefs() const;
+        void SetMethodRefs(base::ArrayRef<const uint32_t> ids);
+
+        const RefSet &GetMethodRefs() const;
 
     private:
         StringId *string_id_;
         //value=method index id
-        std::set<uint32_t> method_ref_idx;
+        RefSet method_ref_idx;
         DISALLOW_COPY_AND_ASSIGN(TypeId);
     };
 
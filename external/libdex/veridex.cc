@@ -16,7 +16,11 @@
 
 #include "veridex.h"
 
-#include "libbase/file.h"
+#include <sys/mman.h>
+
+#include "libbase/fd_file.h"
+#include "libbase/os.h"
+#include "libbase/thread_pool.h"
 
 #include "dex/dex_file.h"
 
@@ -128,119 +132,36 @@ namespace dex_ir {
                 return 1;
             }
 
-            gTargetSdkVersion = options->target_sdk_version;
-
-            std::vector<std::string> boot_content;
-            std::vector<std::string> app_content;
-            std::vector<std::unique_ptr<const libdex::DexFile>> boot_dex_files;
-            std::vector<std::unique_ptr<const libdex::DexFile>> app_dex_files;
             std::string error_msg;
-
-            // Read the boot classpath.
-            std::vector<std::string> boot_classpath = Split(options->core_stubs, ':');
-            boot_content.resize(boot_classpath.size());
-            uint32_t i = 0;
-            for (const std::string &str : boot_classpath) {
-                if (!Load(str, boot_content[i++], &boot_dex_files, &error_msg)) {
-                    LOG(ERROR) << error_msg;
-                    return 1;
-                }
-            }
-            // Read the apps dex files.
-            std::vector<std::string> app_files = options->dex_files_path;
-            app_content.resize(app_files.size());
-            i = 0;
-            for (const std::string &str : app_files) {
-                if (!Load(str, app_content[i++], &app_dex_files, &error_msg)) {
-                    LOG(ERROR) << error_msg;
-                    return 1;
-                }
-            }
-
-            // Resolve classes/methods/fields defined in each dex file.
-
-            // Cache of types we've seen, for quick class name lookups.
-            TypeMap type_map;
-            // Add internally defined primitives.
-            type_map["Z"] = VeriClass::boolean_;
-            type_map["B"] = VeriClass::byte_;
-            type_map["S"] = VeriClass::short_;
-            type_map["C"] = VeriClass::char_;
-            type_map["I"] = VeriClass::integer_;
-            type_map["F"] = VeriClass::float_;
-            type_map["D"] = VeriClass::double_;
-            type_map["J"] = VeriClass::long_;
-            type_map["V"] = VeriClass::void_;
-
-            // Cache of resolvers, to easily query address in memory to VeridexResolver.
-            DexResolverMap resolver_map;
-
-            std::vector<std::unique_ptr<VeridexResolver>> boot_resolvers;
-            Resolve(boot_dex_files, resolver_map, type_map, &boot_resolvers);
-
-            // Now that boot classpath has been resolved, fill classes and reflection
-            // methods.
-            VeriClass::object_ = type_map["Ljava/lang/Object;"];
-            VeriClass::class_ = type_map["Ljava/lang/Class;"];
-            VeriClass::class_loader_ = type_map["Ljava/lang/ClassLoader;"];
-            VeriClass::string_ = type_map["Ljava/lang/String;"];
-            VeriClass::throwable_ = type_map["Ljava/lang/Throwable;"];
-            VeriClass::forName_ = boot_resolvers[0]->LookupDeclaredMethodIn(
-                    *VeriClass::class_, "forName", "(Ljava/lang/String;)Ljava/lang/Class;");
-            VeriClass::getField_ = boot_resolvers[0]->LookupDeclaredMethodIn(
-                    *VeriClass::class_, "getField", "(Ljava/lang/String;)Ljava/lang/reflect/Field;");
-            VeriClass::getDeclaredField_ = boot_resolvers[0]->LookupDeclaredMethodIn(
-                    *VeriClass::class_, "getDeclaredField", "(Ljava/lang/String;)Ljava/lang/reflect/Field;");
-            VeriClass::getMethod_ = boot_resolvers[0]->LookupDeclaredMethodIn(
-                    *VeriClass::class_,
-                    "getMethod",
-                    "(Ljava/lang/String;[Ljava/lang/Class;)Ljava/lang/reflect/Method;");
-            VeriClass::getDeclaredMethod_ = boot_resolvers[0]->LookupDeclaredMethodIn(
-                    *VeriClass::class_,
-                    "getDeclaredMethod",
-                    "(Ljava/lang/String;[Ljava/lang/Class;)Ljava/lang/reflect/Method;");
-            VeriClass::getClass_ = boot_resolvers[0]->LookupDeclaredMethodIn(
-                    *VeriClass::object_, "getClass", "()Ljava/lang/Class;");
-            VeriClass::loadClass_ = boot_resolvers[0]->LookupDeclaredMethodIn(
-                    *VeriClass::class_loader_, "loadClass", "(Ljava/lang/String;)Ljava/lang/Class;");
-
-            VeriClass *version = type_map["Landroid/os/Build$VERSION;"];
-            if (version != nullptr) {
-                VeriClass::sdkInt_ = boot_resolvers[0]->LookupFieldIn(*version, "SDK_INT", "I");
-            }
-
-            std::vector<std::unique_ptr<VeridexResolver>> app_resolvers;
-            Resolve(app_dex_files, resolver_map, type_map, &app_resolvers);
-
-            // Find and log uses of hidden APIs.
-            HiddenApi hidden_api(options->flags_file, options->only_report_sdk_uses);
-            HiddenApiStats stats;
-
-            HiddenApiFinder api_finder(hidden_api);
-            api_finder.Run(app_resolvers);
-            api_finder.Dump(std::cout, &stats, !options->precise, greylist, blacklist, greylist_max_o, greylist_max_p);
-
-            if (options->precise) {
-                PreciseHiddenApiFinder precise_api_finder(hidden_api);
-                precise_api_finder.Run(app_resolvers);
-                precise_api_finder.Dump(std::cout, &stats, greylist, blacklist, greylist_max_o, greylist_max_p);
+            std::unique_ptr<VeridexBatch> batch(VeridexBatch::Create(*options, &error_msg));
+            if (batch == nullptr) {
+                LOG(ERROR) << error_msg;
+                return 1;
             }
-            DumpSummaryStats(std::cout, stats, options);
 
-            if (options->precise) {
-                std::cout << "To run an analysis that can give more reflection accesses, " << std::endl
-                          << "but could include false positives, pass the --imprecise flag. " << std::endl;
+            VeridexReport report;
+            report.greylist.swap(greylist);
+            report.blacklist.swap(blacklist);
+            report.greylist_max_o.swap(greylist_max_o);
+            report.greylist_max_p.swap(greylist_max_p);
+            batch->Check(options->dex_files_path, &report);
+            greylist.swap(report.greylist);
+            blacklist.swap(report.blacklist);
+            greylist_max_o.swap(report.greylist_max_o);
+            greylist_max_p.swap(report.greylist_max_p);
+            if (report.status != 0) {
+                LOG(ERROR) << report.error_msg;
+                return report.status;
             }
-
+            std::cout << report.output;
             return 0;
         }
 
-    private:
         static void DumpSummaryStats(std::ostream &os,
                                      const HiddenApiStats &stats,
-                                     const VeridexOptions *options) {
+                                     bool only_report_sdk_uses) {
             static const char *kPrefix = "       ";
-            if (options->only_report_sdk_uses) {
+            if (only_report_sdk_uses) {
                 os << stats.api_counts[libdex::hiddenapi::ApiList::Whitelist().GetIntValue()]
                    << " SDK API uses." << std::endl;
             } else {
@@ -257,7 +178,7 @@ namespace dex_ir {
         }
 
         static bool Load(const std::string &filename,
-                         std::string &content,
+                         std::vector<base::MemMap> *maps,
                          std::vector<std::unique_ptr<const libdex::DexFile>> *dex_files,
                          std::string *error_msg) {
             if (filename.empty()) {
@@ -265,18 +186,33 @@ namespace dex_ir {
                 return false;
             }
 
-            // TODO: once added, use an api to android::base to read a std::vector<uint8_t>.
-            if (!base::ReadFileToString(filename.c_str(), &content)) {
-                *error_msg = "ReadFileToString failed for " + filename;
+            // The dex file is only read, map it rather than copying it to the heap.
+            base::MemMap::Init();
+            std::unique_ptr<base::File> file(base::OS::OpenFileForReading(filename.c_str()));
+            if (file == nullptr) {
+                *error_msg = "Failed to open " + filename;
+                return false;
+            }
+            int64_t length = file->GetLength();
+            if (length < static_cast<int64_t>(sizeof(libdex::DexFile::Header))) {
+                *error_msg = "Too small to be a dex file: " + filename;
+                return false;
+            }
+            base::MemMap mem_map = base::MemMap::MapFile(static_cast<size_t>(length),
+                                                         PROT_READ,
+                                                         MAP_PRIVATE,
+                                                         file->Fd(),
+                                                         /*start=*/ 0,
+                                                         /*low_4gb=*/ false,
+                                                         filename.c_str(),
+                                                         error_msg);
+            if (!mem_map.IsValid()) {
                 return false;
             }
-            static constexpr bool kVerifyChecksum = false;
-            static constexpr bool kRunDexFileVerifier = true;
-
-            const libdex::DexFile::Header *dex_header = reinterpret_cast<const libdex::DexFile::Header *>(content.data());
             std::unique_ptr<const libdex::DexFile> dex_file;
-            dex_file.reset(libdex::DexFile::getDexFile((const uint8_t *) content.data(), content.size()));
+            dex_file.reset(libdex::DexFile::getDexFile(mem_map.Begin(), mem_map.Size()));
             dex_files->push_back(std::move(dex_file));
+            maps->push_back(std::move(mem_map));
             return true;
         }
 
@@ -297,6 +233,142 @@ namespace dex_ir {
         }
     };
 
+    VeridexBatch::~VeridexBatch() {
+    }
+
+    VeridexBatch *VeridexBatch::Create(const VeridexOptions &options, std::string *error_msg) {
+        gTargetSdkVersion = options.target_sdk_version;
+
+        std::unique_ptr<VeridexBatch> batch(new VeridexBatch());
+        batch->precise_ = options.precise;
+        batch->only_report_sdk_uses_ = options.only_report_sdk_uses;
+
+        // Read the boot classpath.
+        std::vector<std::string> boot_classpath = Split(options.core_stubs, ':');
+        for (const std::string &str : boot_classpath) {
+            if (!Veridex::Load(str, &batch->boot_maps_, &batch->boot_dex_files_, error_msg)) {
+                return nullptr;
+            }
+        }
+
+        // Resolve classes/methods/fields defined in each dex file.
+
+        // Cache of types we've seen, for quick class name lookups.
+        TypeMap &type_map = batch->type_map_;
+        // Add internally defined primitives.
+        type_map["Z"] = VeriClass::boolean_;
+        type_map["B"] = VeriClass::byte_;
+        type_map["S"] = VeriClass::short_;
+        type_map["C"] = VeriClass::char_;
+        type_map["I"] = VeriClass::integer_;
+        type_map["F"] = VeriClass::float_;
+        type_map["D"] = VeriClass::double_;
+        type_map["J"] = VeriClass::long_;
+        type_map["V"] = VeriClass::void_;
+
+        std::vector<std::unique_ptr<VeridexResolver>> &boot_resolvers = batch->boot_resolvers_;
+        Veridex::Resolve(batch->boot_dex_files_, batch->resolver_map_, type_map, &boot_resolvers);
+
+        // Now that boot classpath has been resolved, fill classes and reflection
+        // methods.
+        VeriClass::object_ = type_map["Ljava/lang/Object;"];
+        VeriClass::class_ = type_map["Ljava/lang/Class;"];
+        VeriClass::class_loader_ = type_map["Ljava/lang/ClassLoader;"];
+        VeriClass::string_ = type_map["Ljava/lang/String;"];
+        VeriClass::throwable_ = type_map["Ljava/lang/Throwable;"];
+        VeriClass::forName_ = boot_resolvers[0]->LookupDeclaredMethodIn(
+                *VeriClass::class_, "forName", "(Ljava/lang/String;)Ljava/lang/Class;");
+        VeriClass::getField_ = boot_resolvers[0]->LookupDeclaredMethodIn(
+                *VeriClass::class_, "getField", "(Ljava/lang/String;)Ljava/lang/reflect/Field;");
+        VeriClass::getDeclaredField_ = boot_resolvers[0]->LookupDeclaredMethodIn(
+                *VeriClass::class_, "getDeclaredField", "(Ljava/lang/String;)Ljava/lang/reflect/Field;");
+        VeriClass::getMethod_ = boot_resolvers[0]->LookupDeclaredMethodIn(
+                *VeriClass::class_,
+                "getMethod",
+                "(Ljava/lang/String;[Ljava/lang/Class;)Ljava/lang/reflect/Method;");
+        VeriClass::getDeclaredMethod_ = boot_resolvers[0]->LookupDeclaredMethodIn(
+                *VeriClass::class_,
+                "getDeclaredMethod",
+                "(Ljava/lang/String;[Ljava/lang/Class;)Ljava/lang/reflect/Method;");
+        VeriClass::getClass_ = boot_resolvers[0]->LookupDeclaredMethodIn(
+                *VeriClass::object_, "getClass", "()Ljava/lang/Class;");
+        VeriClass::loadClass_ = boot_resolvers[0]->LookupDeclaredMethodIn(
+                *VeriClass::class_loader_, "loadClass", "(Ljava/lang/String;)Ljava/lang/Class;");
+
+        VeriClass *version = type_map["Landroid/os/Build$VERSION;"];
+        if (version != nullptr) {
+            VeriClass::sdkInt_ = boot_resolvers[0]->LookupFieldIn(*version, "SDK_INT", "I");
+        }
+
+        // Resolve every type the boot classpath refers to now, so that looking up members of boot
+        // classes on behalf of an app never writes to the boot resolvers or to type_map_.
+        for (const std::unique_ptr<VeridexResolver> &resolver : boot_resolvers) {
+            for (uint32_t i = 0; i < resolver->GetDexFile().NumTypeIds(); ++i) {
+                resolver->GetVeriClass(libdex::dex::TypeIndex(i));
+            }
+        }
+
+        batch->hidden_api_.reset(new HiddenApi(options.flags_file, options.only_report_sdk_uses));
+        return batch.release();
+    }
+
+    void VeridexBatch::Check(const std::vector<std::string> &app_files, VeridexReport *report) const {
+        if (app_files.empty()) {
+            report->status = 1;
+            report->error_msg = std::string("Required argument '") + kDexFileOption + "' not provided.";
+            return;
+        }
+
+        // Read the apps dex files.
+        std::vector<base::MemMap> app_maps;
+        std::vector<std::unique_ptr<const libdex::DexFile>> app_dex_files;
+        for (const std::string &str : app_files) {
+            if (!Veridex::Load(str, &app_maps, &app_dex_files, &report->error_msg)) {
+                report->status = 1;
+                return;
+            }
+        }
+
+        // The app sees the boot classpath and its own classes only.
+        TypeMap type_map(type_map_);
+        DexResolverMap resolver_map(resolver_map_);
+        std::vector<std::unique_ptr<VeridexResolver>> app_resolvers;
+        Veridex::Resolve(app_dex_files, resolver_map, type_map, &app_resolvers);
+
+        // Find and log uses of hidden APIs.
+        std::ostringstream os;
+        HiddenApiStats stats;
+
+        HiddenApiFinder api_finder(*hidden_api_);
+        api_finder.Run(app_resolvers);
+        api_finder.Dump(os, &stats, !precise_, report->greylist, report->blacklist, report->greylist_max_o,
+                        report->greylist_max_p);
+
+        if (precise_) {
+            PreciseHiddenApiFinder precise_api_finder(*hidden_api_);
+            precise_api_finder.Run(app_resolvers);
+            precise_api_finder.Dump(os, &stats, report->greylist, report->blacklist, report->greylist_max_o,
+                                    report->greylist_max_p);
+        }
+        Veridex::DumpSummaryStats(os, stats, only_report_sdk_uses_);
+
+        if (precise_) {
+            os << "To run an analysis that can give more reflection accesses, " << std::endl
+               << "but could include false positives, pass the --imprecise flag. " << std::endl;
+        }
+        report->output = os.str();
+    }
+
+    std::vector<VeridexReport> VeridexBatch::Run(const std::vector<std::vector<std::string>> &apps,
+                                                 size_t thread_count) const {
+        std::vector<VeridexReport> reports(apps.size());
+        base::ThreadPool thread_pool(thread_count);
+        thread_pool.ParallelFor(apps.size(), [&](size_t index) {
+            Check(apps[index], &reports[index]);
+        });
+        return reports;
+    }
+
     int CheckHiddenAPI(VeridexOptions *veridexOptions, std::map<std::string, std::vector<std::string>> &greylist,
                        std::map<std::string, std::vector<std::string>> &blacklist,
                        std::map<std::string, std::vector<std::string>> &greylist_max_o,
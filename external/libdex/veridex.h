@@ -18,9 +18,13 @@
 #define ART_TOOLS_VERIDEX_VERIDEX_H_
 
 #include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "dex/primitive.h"
 #include "dex/dex_file.h"
+#include "libbase/mem_map.h"
 
 namespace dex_ir {
     struct VeridexOptions {
@@ -120,6 +124,59 @@ namespace dex_ir {
  */
     using TypeMap = std::map<std::string, VeriClass *>;
 
+    class HiddenApi;
+
+    class VeridexResolver;
+
+/**
+ * Hidden API uses of one app, as CheckHiddenAPI reports them.
+ */
+    struct VeridexReport {
+        int status = 0;
+        std::string error_msg;
+        std::map<std::string, std::vector<std::string>> greylist;
+        std::map<std::string, std::vector<std::string>> blacklist;
+        std::map<std::string, std::vector<std::string>> greylist_max_o;
+        std::map<std::string, std::vector<std::string>> greylist_max_p;
+        // The summary CheckHiddenAPI prints on std::cout.
+        std::string output;
+    };
+
+/**
+ * Loads the boot classpath and the hidden API lists of the options once and checks many apps
+ * against them. The boot classpath is fully resolved up front and only read afterwards, every
+ * app gets its own copies of the type and resolver maps, so apps can be checked concurrently.
+ */
+    class VeridexBatch {
+    public:
+        ~VeridexBatch();
+
+        // Returns nullptr and sets |error_msg| when a boot classpath dex file cannot be loaded.
+        static VeridexBatch *Create(const VeridexOptions &options, std::string *error_msg);
+
+        // Checks the app made of the dex files at |app_files|. The lists of |report| are added to
+        // the same way CheckHiddenAPI adds to its arguments.
+        void Check(const std::vector<std::string> &app_files, VeridexReport *report) const;
+
+        // Checks every app on |thread_count| threads. Reports are in the order of |apps| and do not
+        // depend on the number of threads.
+        std::vector<VeridexReport> Run(const std::vector<std::vector<std::string>> &apps,
+                                       size_t thread_count) const;
+
+    private:
+        VeridexBatch() = default;
+
+        bool precise_ = true;
+        bool only_report_sdk_uses_ = false;
+        std::vector<base::MemMap> boot_maps_;
+        std::vector<std::unique_ptr<const libdex::DexFile>> boot_dex_files_;
+        std::unique_ptr<HiddenApi> hidden_api_;
+        TypeMap type_map_;
+        std::map<uintptr_t, VeridexResolver *> resolver_map_;
+        // Declared last, the resolvers refer to the maps and dex files above.
+        std::vector<std::unique_ptr<VeridexResolver>> boot_resolvers_;
+    };
+
     int CheckHiddenAPI(VeridexOptions *veridexOptions, std::map<std::string, std::vector<std::string>> &greylist,
                        std::map<std::string, std::vector<std::string>> &blacklist,
                        std::map<std::string, std::vector<std::string>> &greylist_max_o,
@@ -0,0 +1,374 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <libbase/fd_file.h>
+#include <libbase/os.h>
+#include "xref_index.h"
+#include "header.h"
+#include "dex/dex_instruction-inl.h"
+
+namespace dex_ir {
+
+    namespace {
+        constexpr uint8_t kXrefIndexMagic[8] = {'d', 'e', 'x', 'x', 'r', 'e', 'f', '\0'};
+        constexpr uint32_t kXrefIndexVersion = 1;
+
+        struct XrefIndexFileHeader {
+            uint8_t magic[8];
+            uint32_t version;
+            uint32_t file_size;
+            uint32_t dex_checksum;
+            uint8_t dex_signature[libdex::DexFile::kSha1DigestSize];
+            uint32_t num_rows[XrefIndex::kRefKindCount * 2];
+            uint32_t num_edges[XrefIndex::kRefKindCount * 2];
+            uint32_t table_offsets[XrefIndex::kRefKindCount * 2];
+        };
+
+        // Refs found in a contiguous run of method items, filled by one task.
+        struct ChunkRefs {
+            std::vector<uint32_t> row_sizes[XrefIndex::kRefKindCount];
+            std::vector<uint32_t> targets[XrefIndex::kRefKindCount];
+        };
+
+        uint32_t NumIds(const Header *header, XrefIndex::RefKind kind) {
+            switch (kind) {
+                case XrefIndex::kMethodRef:
+                    return header->MethodIds().Size();
+                case XrefIndex::kStringRef:
+                    return header->StringIds().Size();
+                case XrefIndex::kTypeRef:
+                    return header->TypeIds().Size();
+                case XrefIndex::kFieldRef:
+                    return header->FieldIds().Size();
+                default:
+                    LOG(FATAL) << "Unexpected ref kind " << kind;
+                    UNREACHABLE();
+            }
+        }
+
+        // Returns the id referenced by |inst| and sets |kind|, or returns false for instructions
+        // without a string, type, field or method index.
+        bool DecodeRef(const libdex::Instruction &inst, XrefIndex::RefKind *kind, uint32_t *index) {
+            switch (libdex::Instruction::IndexTypeOf(inst.Opcode())) {
+                case libdex::Instruction::kIndexTypeRef:
+                    *kind = XrefIndex::kTypeRef;
+                    break;
+                case libdex::Instruction::kIndexStringRef:
+                    *kind = XrefIndex::kStringRef;
+                    break;
+                case libdex::Instruction::kIndexMethodRef:
+                    *kind = XrefIndex::kMethodRef;
+                    break;
+                case libdex::Instruction::kIndexFieldRef:
+                    *kind = XrefIndex::kFieldRef;
+                    break;
+                default:
+                    return false;
+            }
+            switch (libdex::Instruction::FormatOf(inst.Opcode())) {
+                case libdex::Instruction::k21c:
+                case libdex::Instruction::k31c:
+                case libdex::Instruction::k35c:
+                case libdex::Instruction::k3rc:
+                    *index = inst.VRegB();
+                    return true;
+                case libdex::Instruction::k22c:
+                    *index = inst.VRegC();
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        void CollectRefs(MethodItem *method_item, const uint32_t num_ids[], ChunkRefs *refs) {
+            size_t starts[XrefIndex::kRefKindCount];
+            for (size_t kind = 0; kind < XrefIndex::kRefKindCount; ++kind) {
+                starts[kind] = refs->targets[kind].size();
+            }
+            const CodeItem *code = method_item->GetCodeItem();
+            if (code != nullptr) {
+                for (const libdex::DexInstructionPcPair &inst : code->Instructions()) {
+                    if (inst->SizeInCodeUnits() == 0) {
+                        LOG(WARNING) << "GLITCH: zero-width instruction at idx=0x" << std::hex << inst.DexPc();
+                        break;
+                    }
+                    XrefIndex::RefKind kind;
+                    uint32_t index;
+                    if (DecodeRef(inst.Inst(), &kind, &index) && index < num_ids[kind]) {
+                        refs->targets[kind].push_back(index);
+                    }
+                }
+            }
+            for (size_t kind = 0; kind < XrefIndex::kRefKindCount; ++kind) {
+                std::vector<uint32_t> &targets = refs->targets[kind];
+                std::sort(targets.begin() + starts[kind], targets.end());
+                targets.erase(std::unique(targets.begin() + starts[kind], targets.end()), targets.end());
+                refs->row_sizes[kind].push_back(targets.size() - starts[kind]);
+            }
+        }
+
+        bool CheckTable(const uint32_t *offsets, const uint32_t *targets, uint32_t num_rows,
+                        uint32_t num_edges, uint32_t num_targets) {
+            if (offsets[0] != 0 || offsets[num_rows] != num_edges) {
+                return false;
+            }
+            for (uint32_t row = 0; row < num_rows; ++row) {
+                if (offsets[row] > offsets[row + 1]) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < num_edges; ++i) {
+                if (targets[i] >= num_targets) {
+                    return false;
+                }
+            }
+            // RefSet views binary search the rows, they must be strictly increasing.
+            for (uint32_t row = 0; row < num_rows; ++row) {
+                for (uint32_t i = offsets[row] + 1; i < offsets[row + 1]; ++i) {
+                    if (targets[i - 1] >= targets[i]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    XrefIndex::XrefIndex(uint32_t checksum, const uint8_t *signature) : checksum_(checksum) {
+        memcpy(signature_, signature, sizeof(signature_));
+    }
+
+    XrefIndex::~XrefIndex() {
+    }
+
+    XrefIndex *XrefIndex::Build(Header *header, base::ThreadPool *thread_pool) {
+        std::vector<MethodItem *> method_items;
+        method_items.reserve(header->MethodItems().size());
+        for (auto &entry : header->MethodItems()) {
+            method_items.push_back(entry.second);
+        }
+        uint32_t num_ids[kRefKindCount];
+        for (size_t kind = 0; kind < kRefKindCount; ++kind) {
+            num_ids[kind] = NumIds(header, static_cast<RefKind>(kind));
+        }
+
+        // Chunks are fixed up front so that the merge below sees the buffers in method order.
+        const size_t chunk_size = std::max<size_t>(
+                64u, method_items.size() / (thread_pool->GetThreadCount() * 8u));
+        const size_t num_chunks = (method_items.size() + chunk_size - 1) / chunk_size;
+        std::vector<ChunkRefs> chunks(num_chunks);
+        thread_pool->ParallelFor(num_chunks, [&](size_t chunk) {
+            size_t end = std::min(method_items.size(), (chunk + 1) * chunk_size);
+            for (size_t i = chunk * chunk_size; i < end; ++i) {
+                CollectRefs(method_items[i], num_ids, &chunks[chunk]);
+            }
+        });
+
+        XrefIndex *index = new XrefIndex(header->Checksum(), header->Signature());
+        const uint32_t num_method_ids = num_ids[kMethodRef];
+        for (size_t kind = 0; kind < kRefKindCount; ++kind) {
+            // Method -> ids. Method items are ordered by method index, so the chunk buffers only need
+            // to be concatenated.
+            std::vector<uint32_t> &offsets = index->offsets_storage_[kind * 2];
+            std::vector<uint32_t> &targets = index->targets_storage_[kind * 2];
+            offsets.assign(num_method_ids + 1, 0u);
+            std::vector<size_t> chunk_starts(num_chunks + 1, 0u);
+            for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+                const std::vector<uint32_t> &row_sizes = chunks[chunk].row_sizes[kind];
+                for (size_t i = 0; i < row_sizes.size(); ++i) {
+                    offsets[method_items[chunk * chunk_size + i]->GetRawId() + 1] = row_sizes[i];
+                }
+                chunk_starts[chunk + 1] = chunk_starts[chunk] + chunks[chunk].targets[kind].size();
+            }
+            for (uint32_t row = 0; row < num_method_ids; ++row) {
+                offsets[row + 1] += offsets[row];
+            }
+            targets.resize(chunk_starts[num_chunks]);
+            thread_pool->ParallelFor(num_chunks, [&](size_t chunk) {
+                std::vector<uint32_t> &chunk_targets = chunks[chunk].targets[kind];
+                std::copy(chunk_targets.begin(), chunk_targets.end(), targets.begin() + chunk_starts[chunk]);
+                std::vector<uint32_t>().swap(chunk_targets);
+            });
+
+            // Id -> methods, a counting sort of the edges above. Rows are filled in method order and
+            // therefore come out sorted.
+            std::vector<uint32_t> &reverse_offsets = index->offsets_storage_[kind * 2 + 1];
+            std::vector<uint32_t> &reverse_targets = index->targets_storage_[kind * 2 + 1];
+            reverse_offsets.assign(num_ids[kind] + 1, 0u);
+            for (uint32_t target : targets) {
+                ++reverse_offsets[target + 1];
+            }
+            for (uint32_t row = 0; row < num_ids[kind]; ++row) {
+                reverse_offsets[row + 1] += reverse_offsets[row];
+            }
+            reverse_targets.resize(targets.size());
+            std::vector<uint32_t> cursors(reverse_offsets.begin(), reverse_offsets.end() - 1);
+            for (uint32_t method_idx = 0; method_idx < num_method_ids; ++method_idx) {
+                for (uint32_t i = offsets[method_idx]; i < offsets[method_idx + 1]; ++i) {
+                    reverse_targets[cursors[targets[i]]++] = method_idx;
+                }
+            }
+        }
+        for (size_t table = 0; table < kNumTables; ++table) {
+            Table &t = index->tables_[table];
+            t.offsets = index->offsets_storage_[table].data();
+            t.targets = index->targets_storage_[table].data();
+            t.num_rows = index->offsets_storage_[table].size() - 1;
+            t.num_edges = index->targets_storage_[table].size();
+        }
+        return index;
+    }
+
+    XrefIndex *XrefIndex::Load(const std::string &path, const Header *header, std::string *error_msg) {
+        // The cache is keyed by the parsed file, edited code would get the references of the original.
+        if (!header->DirtyCodeItems().empty()) {
+            *error_msg = "Code items were edited since the dex file was parsed";
+            return nullptr;
+        }
+        base::MemMap::Init();
+        std::unique_ptr<base::File> file(base::OS::OpenFileForReading(path.c_str()));
+        if (file == nullptr) {
+            *error_msg = "Failed to open " + path;
+            return nullptr;
+        }
+        int64_t length = file->GetLength();
+        if (length < static_cast<int64_t>(sizeof(XrefIndexFileHeader))) {
+            *error_msg = "Too small to be an xref index: " + path;
+            return nullptr;
+        }
+        base::MemMap mem_map = base::MemMap::MapFile(static_cast<size_t>(length),
+                                                     PROT_READ,
+                                                     MAP_PRIVATE,
+                                                     file->Fd(),
+                                                     /*start=*/ 0,
+                                                     /*low_4gb=*/ false,
+                                                     path.c_str(),
+                                                     error_msg);
+        if (!mem_map.IsValid()) {
+            return nullptr;
+        }
+        const XrefIndexFileHeader *file_header = reinterpret_cast<const XrefIndexFileHeader *>(mem_map.Begin());
+        if (memcmp(file_header->magic, kXrefIndexMagic, sizeof(kXrefIndexMagic)) != 0 ||
+            file_header->version != kXrefIndexVersion ||
+            file_header->file_size != static_cast<uint64_t>(length)) {
+            *error_msg = "Not an xref index or unsupported version: " + path;
+            return nullptr;
+        }
+        if (file_header->dex_checksum != header->Checksum() ||
+            memcmp(file_header->dex_signature, header->Signature(), libdex::DexFile::kSha1DigestSize) != 0) {
+            *error_msg = "Xref index was written for another dex file: " + path;
+            return nullptr;
+        }
+        std::unique_ptr<XrefIndex> index(new XrefIndex(header->Checksum(), header->Signature()));
+        const uint32_t num_method_ids = NumIds(header, kMethodRef);
+        for (size_t table = 0; table < kNumTables; ++table) {
+            RefKind kind = static_cast<RefKind>(table / 2);
+            const bool reverse = (table % 2) != 0;
+            const uint32_t num_rows = reverse ? NumIds(header, kind) : num_method_ids;
+            const uint32_t num_targets = reverse ? num_method_ids : NumIds(header, kind);
+            const uint32_t num_edges = file_header->num_edges[table];
+            const uint64_t offset = file_header->table_offsets[table];
+            if (file_header->num_rows[table] != num_rows || offset % sizeof(uint32_t) != 0 ||
+                offset + (static_cast<uint64_t>(num_rows) + 1 + num_edges) * sizeof(uint32_t) >
+                static_cast<uint64_t>(length)) {
+                *error_msg = "Malformed xref index: " + path;
+                return nullptr;
+            }
+            Table &t = index->tables_[table];
+            t.offsets = reinterpret_cast<const uint32_t *>(mem_map.Begin() + offset);
+            t.targets = t.offsets + num_rows + 1;
+            t.num_rows = num_rows;
+            t.num_edges = num_edges;
+            if (!CheckTable(t.offsets, t.targets, num_rows, num_edges, num_targets)) {
+                *error_msg = "Malformed xref index: " + path;
+                return nullptr;
+            }
+        }
+        index->mem_map_ = std::move(mem_map);
+        return index.release();
+    }
+
+    void XrefIndex::FillRefs(Header *header) const {
+        for (uint32_t i = 0; i < header->StringIds().Size(); ++i) {
+            header->StringIds()[i]->SetMethodRefs(GetReferrers(kStringRef, i));
+        }
+        for (uint32_t i = 0; i < header->TypeIds().Size(); ++i) {
+            header->TypeIds()[i]->SetMethodRefs(GetReferrers(kTypeRef, i));
+        }
+        for (uint32_t i = 0; i < header->FieldIds().Size(); ++i) {
+            header->FieldIds()[i]->SetMethodRefs(GetReferrers(kFieldRef, i));
+        }
+        for (uint32_t i = 0; i < header->MethodIds().Size(); ++i) {
+            header->MethodIds()[i]->SetMethodRefs(GetReferrers(kMethodRef, i));
+        }
+        for (auto &entry : header->MethodItems()) {
+            FillRefs(entry.second);
+        }
+    }
+
+    void XrefIndex::FillRefs(MethodItem *method_item) const {
+        const uint32_t method_idx = method_item->GetRawId();
+        method_item->SetMethodRefs(GetRefs(kMethodRef, method_idx));
+        method_item->SetStringRefs(GetRefs(kStringRef, method_idx));
+        method_item->SetTypeRefs(GetRefs(kTypeRef, method_idx));
+        method_item->SetFieldRefs(GetRefs(kFieldRef, method_idx));
+    }
+
+    bool XrefIndex::Save(const std::string &path, std::string *error_msg) const {
+        XrefIndexFileHeader file_header;
+        memset(&file_header, 0, sizeof(file_header));
+        memcpy(file_header.magic, kXrefIndexMagic, sizeof(kXrefIndexMagic));
+        file_header.version = kXrefIndexVersion;
+        file_header.dex_checksum = checksum_;
+        memcpy(file_header.dex_signature, signature_, sizeof(signature_));
+        uint64_t offset = sizeof(XrefIndexFileHeader);
+        for (size_t table = 0; table < kNumTables; ++table) {
+            file_header.num_rows[table] = tables_[table].num_rows;
+            file_header.num_edges[table] = tables_[table].num_edges;
+            file_header.table_offsets[table] = static_cast<uint32_t>(offset);
+            offset += (static_cast<uint64_t>(tables_[table].num_rows) + 1 + tables_[table].num_edges) *
+                      sizeof(uint32_t);
+        }
+        if (offset > UINT32_MAX) {
+            *error_msg = "Xref index too large for " + path;
+            return false;
+        }
+        file_header.file_size = static_cast<uint32_t>(offset);
+
+        std::string temp_path;
+        std::unique_ptr<base::File> file(base::OS::CreateTempFileNextTo(path.c_str(), &temp_path));
+        if (file == nullptr) {
+            *error_msg = "Failed to create a temporary file for " + path;
+            return false;
+        }
+        bool success = file->WriteFully(&file_header, sizeof(file_header));
+        for (size_t table = 0; success && table < kNumTables; ++table) {
+            const Table &t = tables_[table];
+            success = file->WriteFully(t.offsets, (t.num_rows + 1) * sizeof(uint32_t)) &&
+                      file->WriteFully(t.targets, t.num_edges * sizeof(uint32_t));
+        }
+        if (!success) {
+            *error_msg = "Failed to write " + temp_path;
+            file->Erase(/*unlink=*/ true);
+            return false;
+        }
+        if (file->FlushCloseOrErase() != 0) {
+            *error_msg = "Failed to flush " + temp_path;
+            unlink(temp_path.c_str());
+            return false;
+        }
+        if (rename(temp_path.c_str(), path.c_str()) != 0) {
+            *error_msg = "Failed to rename " + temp_path + " to " + path + ": " + strerror(errno);
+            unlink(temp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,104 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#ifndef BASE_XREF_INDEX_H
+#define BASE_XREF_INDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <libbase/array_ref.h>
+#include <libbase/macros.h>
+#include <libbase/mem_map.h>
+#include <libbase/thread_pool.h>
+#include "dex/dex_file.h"
+
+namespace dex_ir {
+    class Header;
+
+    class MethodItem;
+
+    // Cross references between the code of the methods of a dex file and the ids it uses, stored as
+    // compressed sparse rows: for every kind one table maps a method index to the ids its code
+    // references and one maps an id to the methods referencing it. Rows are sorted and unique.
+    //
+    // The index can be saved next to the dex file and mapped back by a later run. The file is keyed
+    // by the checksum and signature of the dex header and is ignored when they do not match.
+    class XrefIndex {
+    public:
+        enum RefKind {
+            kMethodRef = 0,
+            kStringRef,
+            kTypeRef,
+            kFieldRef,
+            kRefKindCount,
+        };
+
+        ~XrefIndex();
+
+        // Decodes the code of every method item of |header|. Methods are split into chunks that
+        // fill their own edge buffers on |thread_pool|, the buffers are merged in method order so
+        // the result does not depend on the number of threads.
+        static XrefIndex *Build(Header *header, base::ThreadPool *thread_pool);
+
+        // Maps an index saved by Save. Returns nullptr and sets |error_msg| when the file is missing,
+        // malformed, was written for another dex file or |header| has dirty code items.
+        static XrefIndex *Load(const std::string &path, const Header *header, std::string *error_msg);
+
+        // Writes the index to |path| through a temporary file that is renamed on success.
+        bool Save(const std::string &path, std::string *error_msg) const;
+
+        // Ids of |kind| referenced by the code of method |method_idx|.
+        base::ArrayRef<const uint32_t> GetRefs(RefKind kind, uint32_t method_idx) const {
+            return GetRow(tables_[kind * 2], method_idx);
+        }
+
+        // Methods whose code references id |idx| of |kind|.
+        base::ArrayRef<const uint32_t> GetReferrers(RefKind kind, uint32_t idx) const {
+            return GetRow(tables_[kind * 2 + 1], idx);
+        }
+
+        uint32_t NumRefs(RefKind kind) const { return tables_[kind * 2].num_edges; }
+
+        bool IsMapped() const { return mem_map_.IsValid(); }
+
+        // Points the Get*Refs() sets of the ids and of the method items decoded so far at the rows of
+        // the index, which must outlive them.
+        void FillRefs(Header *header) const;
+
+        void FillRefs(MethodItem *method_item) const;
+
+    private:
+        static constexpr size_t kNumTables = kRefKindCount * 2;
+
+        struct Table {
+            const uint32_t *offsets = nullptr;  // num_rows + 1 entries.
+            const uint32_t *targets = nullptr;  // num_edges entries.
+            uint32_t num_rows = 0;
+            uint32_t num_edges = 0;
+        };
+
+        XrefIndex(uint32_t checksum, const uint8_t *signature);
+
+        static base::ArrayRef<const uint32_t> GetRow(const Table &table, uint32_t row) {
+            if (row >= table.num_rows) {
+                return base::ArrayRef<const uint32_t>();
+            }
+            return base::ArrayRef<const uint32_t>(table.targets + table.offsets[row],
+                                                  table.offsets[row + 1] - table.offsets[row]);
+        }
+
+        uint32_t checksum_;
+        uint8_t signature_[libdex::DexFile::kSha1DigestSize];
+        Table tables_[kNumTables];
+        // Backing store of tables_, either built in memory or mapped from a saved index.
+        std::vector<uint32_t> offsets_storage_[kNumTables];
+        std::vector<uint32_t> targets_storage_[kNumTables];
+        base::MemMap mem_map_;
+
+        DISALLOW_COPY_AND_ASSIGN(XrefIndex);
+    };
+}
+
+#endif //BASE_XREF_INDEX_H
@@ -8,46 +8,39 @@
 #include <libdex/dex_writer.h>
 #include <libbase/file.h>
 #include <libbase/logging.h>
+#include <libbase/thread_pool.h>
 #include <assert.h>
 
 /**
- * load a dex file
+ * map and parse dex file, class data is decoded on first access
  * @return
  */
-std::unique_ptr<libdex::DexFile> loadDexFile() {
-    //read file
-    std::string dex_data;
-    auto read_success = base::ReadFileToString("classes.dex", &dex_data);
-    assert(read_success);
-    return std::unique_ptr<libdex::DexFile>(libdex::DexFile::getDexFile((uint8_t *) dex_data.data(), dex_data.size()));
-}
-
-/**
- * parse dex file
- * @param mDexFile
- * @return
- */
-std::unique_ptr<dex_ir::Header> parseDexFile(std::unique_ptr<libdex::DexFile> mDexFile) {
-    if (mDexFile->IsMagicValid() && mDexFile->IsVersionValid()) {
-        return std::unique_ptr<dex_ir::Header>(dex_ir::DexIrBuilder(*mDexFile.get(), false));
+std::unique_ptr<dex_ir::Header> parseDexFile(const char *dex_path) {
+    std::string error_msg;
+    auto header = std::unique_ptr<dex_ir::Header>(dex_ir::DexIrLazyBuilder(dex_path, &error_msg));
+    if (header == nullptr) {
+        LOG(ERROR) << "parse dex fail: " << error_msg;
     }
-    return nullptr;
+    return header;
 }
 
 
 int main(int argc, char **argv) {
 
-    auto mHeader = parseDexFile(loadDexFile());
-    //Find all data references
-    dex_ir::Decompilation decompilation(mHeader.get());
-    if (decompilation.loadReferences()) {
+    auto mHeader = parseDexFile("classes.dex");
+    if (mHeader == nullptr) {
+        return -1;
+    }
+    //Find all data references, the index is kept in classes.dex.xref for the next run
+    dex_ir::Decompilation *decompilation = mHeader->GetDecompilation();
+    if (decompilation->loadReferences(base::ThreadPool::DefaultThreadCount(), "classes.dex.xref")) {
         //find which method call System.exit()
-        auto method_id = decompilation.getMethodIdBySignatrue("Ljava/lang/System;", "exit", "(I)V");
+        auto method_id = decompilation->getMethodIdBySignatrue("Ljava/lang/System;", "exit", "(I)V");
         if (method_id != nullptr) {
 
             //get all methods which call "exit"
             for (const auto &methodRef: method_id->GetMethodRefs()) {
-                dex_ir::MethodItem *ref_method_item = mHeader->MethodItems()[methodRef];
+                dex_ir::MethodItem *ref_method_item = mHeader->GetMethodItem(methodRef);
                 if (ref_method_item == nullptr) {
                     continue;
                 }
@@ -62,6 +62,8 @@ bool RepairDex::repairNopCode(dex_ir::CodeItem *codeItem) {
         //something .... eg
         //fix opcode
         memcpy(codeItem->Insns(), nullptr, 0);
+        //let DexWriter::OutputPatched rewrite only this code item
+        mHeader->MarkDirty(codeItem);
 
     }
 
@@ -0,0 +1,70 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <libdex/dex/dex_file.h>
+#include <libdex/header.h>
+#include <libdex/dex_writer.h>
+#include <libbase/file.h>
+#include <libbase/logging.h>
+
+/**
+ * build the IR of a dex file and write it back into memory
+ * @return the written dex file, empty on failure
+ */
+static std::string buildAndOutput(const libdex::DexFile &dex_file, size_t thread_count) {
+    std::unique_ptr<dex_ir::Header> header(dex_ir::DexIrBuilder(dex_file, true, thread_count));
+    std::string error_msg;
+    std::vector<uint8_t> buffer(dex_file.Size() * 2);
+    size_t size = 0;
+    if (!dex_ir::DexWriter::Output(header.get(), buffer.data(), buffer.size(), &size, &error_msg)) {
+        if (size <= buffer.size()) {
+            LOG(ERROR) << "output fail: " << error_msg;
+            return std::string();
+        }
+        buffer.resize(size);
+        if (!dex_ir::DexWriter::Output(header.get(), buffer.data(), buffer.size(), &size, &error_msg)) {
+            LOG(ERROR) << "output fail: " << error_msg;
+            return std::string();
+        }
+    }
+    return std::string(reinterpret_cast<const char *>(buffer.data()), size);
+}
+
+/**
+ * builds the dex file given on the command line serially and with several thread counts,
+ * and checks that every build writes the same bytes
+ */
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        LOG(ERROR) << "usage: dex_ir_builder_test <dex file>";
+        return 1;
+    }
+    std::string data;
+    if (!base::ReadFileToString(argv[1], &data)) {
+        LOG(ERROR) << "read fail: " << argv[1];
+        return 1;
+    }
+    std::unique_ptr<libdex::DexFile> dex_file(
+            libdex::DexFile::getDexFile(reinterpret_cast<const uint8_t *>(data.data()), data.size()));
+    if (dex_file == nullptr) {
+        LOG(ERROR) << "parse dex fail: " << argv[1];
+        return 1;
+    }
+
+    std::string serial = buildAndOutput(*dex_file, 1u);
+    if (serial.empty()) {
+        return 1;
+    }
+    for (size_t thread_count : {2u, 4u, 8u}) {
+        std::string parallel = buildAndOutput(*dex_file, thread_count);
+        if (parallel != serial) {
+            LOG(ERROR) << "output with " << thread_count << " threads differs from the serial build";
+            return 1;
+        }
+    }
+    return 0;
+}
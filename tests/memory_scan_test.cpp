@@ -0,0 +1,185 @@
+//
+// Created by xiaobai on 2026/10/17.
+//
+
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <libbase/memory_scan.h>
+#include <libbase/thread_pool.h>
+#include <libbase/logging.h>
+
+namespace {
+
+    struct Pattern {
+        std::vector<uint8_t> bytes;  // Already masked.
+        std::vector<uint8_t> masks;
+    };
+
+    typedef std::vector<std::pair<const uint8_t *, uint32_t>> MatchList;
+
+    const char kHexDigits[] = "0123456789abcdef";
+
+    /**
+     * format a pattern in the MemoryScan syntax, nibble masks as "?" when |nibbles| is set
+     * and as an explicit ":" mask list otherwise
+     */
+    std::string formatPattern(const Pattern &pattern, bool nibbles) {
+        std::string bytes;
+        std::string masks;
+        bool explicit_masks = false;
+        for (size_t i = 0; i < pattern.bytes.size(); ++i) {
+            const uint8_t byte = pattern.bytes[i];
+            const uint8_t mask = pattern.masks[i];
+            if (nibbles && (mask == 0x00 || mask == 0x0f || mask == 0xf0 || mask == 0xff)) {
+                bytes += (mask & 0xf0) ? kHexDigits[byte >> 4] : '?';
+                bytes += (mask & 0x0f) ? kHexDigits[byte & 0xf] : '?';
+                masks += "ff";
+            } else {
+                bytes += kHexDigits[byte >> 4];
+                bytes += kHexDigits[byte & 0xf];
+                masks += kHexDigits[mask >> 4];
+                masks += kHexDigits[mask & 0xf];
+                explicit_masks = true;
+            }
+            bytes += ' ';
+            masks += ' ';
+        }
+        return explicit_masks ? bytes + ":" + masks : bytes;
+    }
+
+    /**
+     * every (address, pattern) pair that matches, by address then pattern
+     */
+    MatchList bruteForce(const std::vector<uint8_t> &buffer, const std::vector<Pattern> &patterns) {
+        MatchList matches;
+        for (size_t address = 0; address < buffer.size(); ++address) {
+            for (uint32_t index = 0; index < patterns.size(); ++index) {
+                const Pattern &pattern = patterns[index];
+                if (address + pattern.bytes.size() > buffer.size()) {
+                    continue;
+                }
+                size_t k = 0;
+                while (k < pattern.bytes.size() && (buffer[address + k] & pattern.masks[k]) == pattern.bytes[k]) {
+                    ++k;
+                }
+                if (k == pattern.bytes.size()) {
+                    matches.emplace_back(buffer.data() + address, index);
+                }
+            }
+        }
+        return matches;
+    }
+
+    /**
+     * random buffer and patterns, with copies of each pattern planted in the buffer, some of them
+     * across the boundary of the first scan chunk
+     */
+    bool checkRound(std::mt19937_64 &rng, size_t round, base::ThreadPool *thread_pool) {
+        const bool large = round % 3 == 0;
+        const size_t length = large ? (1u << 20) + 4096u + rng() % 5000u : 1u + rng() % 60000u;
+        // A small alphabet gives many overlapping matches.
+        const bool small_alphabet = (round & 1u) != 0u;
+        const unsigned alphabet = 2u + rng() % 6u;
+        auto random_byte = [&]() -> uint8_t {
+            return static_cast<uint8_t>(small_alphabet ? rng() % alphabet : rng());
+        };
+        std::vector<uint8_t> buffer(length);
+        for (uint8_t &byte : buffer) {
+            byte = random_byte();
+        }
+
+        const size_t num_patterns = 1u + rng() % (large ? 24u : 120u);
+        std::vector<Pattern> patterns;
+        std::vector<std::string> pattern_strings;
+        for (size_t i = 0; i < num_patterns; ++i) {
+            Pattern pattern;
+            const size_t size = rng() % 4u == 0u ? 1u + rng() % 3u : 1u + rng() % 24u;
+            bool fixed = false;
+            for (size_t k = 0; k < size; ++k) {
+                // Mostly exact bytes, then wildcards, nibble masks and arbitrary masks.
+                static const uint8_t kMasks[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0xf0, 0x0f};
+                const size_t kind = rng() % (sizeof(kMasks) + 1u);
+                const uint8_t mask = kind < sizeof(kMasks) ? kMasks[kind] : static_cast<uint8_t>(rng());
+                pattern.masks.push_back(mask);
+                pattern.bytes.push_back(random_byte() & mask);
+                fixed |= mask != 0u;
+            }
+            if (!fixed) {
+                pattern.masks[0] = 0xff;
+            }
+            for (int copy = 0; copy < 3 && size <= length; ++copy) {
+                size_t at = rng() % (length - size + 1u);
+                if (copy == 0 && large) {
+                    at = (1u << 20) - rng() % size;
+                }
+                for (size_t k = 0; k < size; ++k) {
+                    buffer[at + k] = (buffer[at + k] & ~pattern.masks[k]) | pattern.bytes[k];
+                }
+            }
+            pattern_strings.push_back(formatPattern(pattern, (rng() & 1u) != 0u));
+            patterns.push_back(std::move(pattern));
+        }
+
+        std::string error_msg;
+        std::unique_ptr<MultiMemoryScan> scan(MultiMemoryScan::Create(pattern_strings, &error_msg));
+        if (scan == nullptr) {
+            LOG(ERROR) << "round " << round << ": create fail: " << error_msg;
+            return false;
+        }
+        const MatchList expected = bruteForce(buffer, patterns);
+        MatchList found;
+        scan->Scan(buffer.data(), buffer.size(), [&found](const MultiMemoryScan::Match *matches, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                found.emplace_back(matches[i].address, matches[i].pattern);
+            }
+            return true;
+        }, thread_pool);
+        if (found != expected) {
+            LOG(ERROR) << "round " << round << ": " << found.size() << " matches, expected " << expected.size()
+                       << " (" << length << " bytes, " << num_patterns << " patterns)";
+            return false;
+        }
+        return true;
+    }
+
+}  // namespace
+
+/**
+ * compares MultiMemoryScan with a brute force search over random buffers and patterns,
+ * serially and on thread pools, and checks that the callback can stop the scan
+ */
+int main() {
+    std::mt19937_64 rng(42);
+    bool ok = true;
+    base::ThreadPool pool1(1u);
+    base::ThreadPool pool3(3u);
+    base::ThreadPool *thread_pools[] = {nullptr, &pool1, &pool3};
+    for (size_t round = 0; round < 12; ++round) {
+        // Every third round crosses a chunk boundary, run those with each pool as well.
+        ok &= checkRound(rng, round, thread_pools[(round + round / 3) % 3]);
+    }
+
+    std::vector<uint8_t> buffer(8u << 20, 0x41);
+    std::string error_msg;
+    std::unique_ptr<MultiMemoryScan> scan(MultiMemoryScan::Create({"41 41"}, &error_msg));
+    size_t calls = 0;
+    bool completed = scan->Scan(buffer.data(), buffer.size(), [&calls](const MultiMemoryScan::Match *, size_t) {
+        return ++calls < 2u;
+    }, &pool3);
+    if (completed || calls != 2u) {
+        LOG(ERROR) << "scan went on after the callback stopped it, " << calls << " calls";
+        ok = false;
+    }
+
+    for (const char *malformed : {"", "4", "zz", "?? ??", "12 34:ff", "12:zz"}) {
+        std::unique_ptr<MultiMemoryScan> rejected(MultiMemoryScan::Create({malformed}, &error_msg));
+        if (rejected != nullptr) {
+            LOG(ERROR) << "accepted malformed pattern \"" << malformed << "\"";
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}